@@ -0,0 +1,142 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "burst.h"
+
+static char const * const idle_names[] = {
+	[BURST_IDLE_SPIN] = "spin",
+	[BURST_IDLE_PAUSE] = "pause",
+	[BURST_IDLE_SLEEP] = "sleep",
+};
+
+uint64_t burst_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+static int parse_ul(char const * const s, char **end, unsigned long int * const res)
+{
+	errno = 0;
+	*res = strtoul(s, end, 0);
+	return errno || *end == s;
+}
+
+int burst_parse(struct burst * const burst, char const * const spec)
+{
+	unsigned long int period, duty = 50, jitter = 0;
+	char *end;
+	size_t i;
+
+	burst->idle = BURST_IDLE_SLEEP;
+
+	if (parse_ul(spec, &end, &period) || !period || period > 3600000)
+		goto err;
+	if (*end == ',' && (parse_ul(end+1, &end, &duty) || !duty || duty > 100))
+		goto err;
+	if (*end == ',' && (parse_ul(end+1, &end, &jitter) || jitter > 100))
+		goto err;
+	if (*end == ',') {
+		for (i=0 ; i<sizeof(idle_names)/sizeof(idle_names[0]) && strcmp(end+1, idle_names[i]) ; i++) ;
+		if (i == sizeof(idle_names)/sizeof(idle_names[0]))
+			goto err;
+		burst->idle = i;
+		end += strlen(end);
+	}
+	if (*end)
+		goto err;
+
+	burst->period = period*1000000;
+	burst->on = burst->period/100*duty;
+	/* Bursts never overlap the next period */
+	burst->jitter = burst->period/100*jitter;
+	if (burst->jitter > burst->period - burst->on)
+		burst->jitter = burst->period - burst->on;
+	burst->epoch = burst_now();
+
+	return 0;
+
+err:
+	fprintf(stderr, "Could not parse %s as period_ms[,duty_percent[,jitter_percent[,spin|pause|sleep]]]\n", spec);
+	return -1;
+}
+
+/* splitmix64 of the burst number */
+static uint64_t burst_start(struct burst const * const burst, const uint64_t n)
+{
+	uint64_t z = n + 0x9e3779b97f4a7c15ULL;
+
+	if (!burst->jitter)
+		return burst->epoch + n*burst->period;
+
+	z = (z ^ z >> 30) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ z >> 27) * 0x94d049bb133111ebULL;
+	z ^= z >> 31;
+
+	return burst->epoch + n*burst->period + z%(burst->jitter+1);
+}
+
+static void idle_until(struct burst const * const burst, const uint64_t until)
+{
+	struct timespec ts;
+
+	switch (burst->idle) {
+		case BURST_IDLE_SPIN:
+			while (burst_now() < until) ;
+			break;
+		case BURST_IDLE_PAUSE:
+			while (burst_now() < until) {
+#if ARCH_X86_64
+				asm volatile("pause");
+#endif
+			}
+			break;
+		case BURST_IDLE_SLEEP:
+			ts.tv_sec = until / 1000000000;
+			ts.tv_nsec = until % 1000000000;
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) ;
+			break;
+	}
+}
+
+uint64_t burst_wait(struct burst const * const burst, const uint64_t max_wait)
+{
+	const uint64_t now = burst_now();
+	const uint64_t n = (now - burst->epoch) / burst->period;
+	uint64_t start = burst_start(burst, n);
+
+	if (now >= start && now < start + burst->on)
+		return start;
+	if (now >= start)
+		start = burst_start(burst, n+1);
+
+	idle_until(burst, start - now > max_wait ? now + max_wait : start);
+
+	return 0;
+}
+
+int burst_active(struct burst const * const burst, const uint64_t start)
+{
+	return burst_now() < start + burst->on;
+}
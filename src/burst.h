@@ -0,0 +1,51 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#ifndef BURST_H
+#define BURST_H
+
+#include <stdint.h>
+
+enum burst_idle {
+	BURST_IDLE_SPIN,
+	BURST_IDLE_PAUSE,
+	BURST_IDLE_SLEEP,
+};
+
+/* Bursts of on ns start every period ns from epoch (CLOCK_MONOTONIC),
+ * delayed by up to jitter ns. Delays only depend on the burst number, so
+ * that every thread bursts at the same time. */
+struct burst {
+	uint64_t epoch;
+	uint64_t period;
+	uint64_t on;
+	uint64_t jitter;
+	enum burst_idle idle;
+};
+
+/* Parses "period_ms[,duty_percent[,jitter_percent[,spin|pause|sleep]]]",
+ * returns non-zero on failure */
+int burst_parse(struct burst * const burst, char const * const spec);
+
+/* Returns the start of the current burst, or waits for at most max_wait
+ * ns towards the next one and returns 0 */
+uint64_t burst_wait(struct burst const * const burst, const uint64_t max_wait);
+/* Returns non-zero while the burst that started at start is running */
+int burst_active(struct burst const * const burst, const uint64_t start);
+
+uint64_t burst_now(void);
+
+#endif
@@ -0,0 +1,350 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#if HAVE_SCHED_H
+#include <sched.h>
+#endif
+#include "c2c.h"
+
+#define CACHE_LINE_SIZE 64
+#define PAYLOAD_WORDS (CACHE_LINE_SIZE/sizeof(uint64_t)-1)
+#define WARMUP_ROUNDTRIPS 1000
+#define SPINS_BEFORE_YIELD (1UL<<16)
+/* A pair is an outlier when it is both OUTLIER_RATIO times slower than the
+ * median of its topology class and more than OUTLIER_MADS median absolute
+ * deviations away from it */
+#define OUTLIER_RATIO 1.5
+#define OUTLIER_MADS 5.0
+
+/* The whole line bounces between the two cpus, seq tells which hop the
+ * payload belongs to */
+struct line {
+	uint64_t seq;
+	uint64_t payload[PAYLOAD_WORDS];
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct side_error {
+	unsigned long int count;
+	uint64_t hop;
+	size_t word;
+	uint64_t expected;
+	uint64_t got;
+};
+
+struct pair {
+	struct line line;
+	int cpus[2];
+	unsigned long int roundtrips;
+	unsigned int ready;
+	int aborted;
+	int pin_failed;
+	double ns;
+	struct side_error errors[2];
+};
+
+struct side {
+	pthread_t thread;
+	struct pair *pair;
+	unsigned int idx;
+};
+
+static uint64_t payload_word(const uint64_t hop, const size_t word)
+{
+	uint64_t x = hop * 0x9e3779b97f4a7c15ULL + word;
+
+	x ^= x >> 31;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+
+	return x;
+}
+
+/* Returns non-zero if the pair got aborted */
+static int start_barrier(struct pair * const pair)
+{
+	unsigned long int spins;
+
+	__atomic_add_fetch(&pair->ready, 1, __ATOMIC_ACQ_REL);
+	for (spins=0 ; __atomic_load_n(&pair->ready, __ATOMIC_ACQUIRE) != 2 ; spins++) {
+		if (__atomic_load_n(&pair->aborted, __ATOMIC_ACQUIRE))
+			return -1;
+		if (spins >= SPINS_BEFORE_YIELD)
+			sched_yield();
+	}
+
+	return 0;
+}
+
+static void wait_hop(struct line * const line, const uint64_t hop)
+{
+	unsigned long int spins;
+
+	for (spins=0 ; __atomic_load_n(&line->seq, __ATOMIC_ACQUIRE) != hop ; spins++)
+		if (spins >= SPINS_BEFORE_YIELD)
+			sched_yield();
+}
+
+static void * side_func(void *arg)
+{
+	struct side * const side = arg;
+	struct pair * const pair = side->pair;
+	struct side_error * const err = &pair->errors[side->idx];
+	const uint64_t timed_from = 2*WARMUP_ROUNDTRIPS+1;
+	const uint64_t last_hop = 2*(WARMUP_ROUNDTRIPS+pair->roundtrips);
+	struct timespec start, end;
+	uint64_t hop;
+	size_t w;
+
+	if (pin_thread(pthread_self(), pair->cpus[side->idx]))
+		__atomic_store_n(&pair->pin_failed, 1, __ATOMIC_RELAXED);
+
+	if (start_barrier(pair))
+		return NULL;
+
+	/* Side 0 writes odd hops, side 1 even ones */
+	for (hop=1 ; hop<=last_hop ; hop++) {
+		if (hop%2 != side->idx) {
+			if (hop == timed_from)
+				clock_gettime(CLOCK_MONOTONIC, &start);
+			for (w=0 ; w<PAYLOAD_WORDS ; w++)
+				pair->line.payload[w] = payload_word(hop, w);
+			__atomic_store_n(&pair->line.seq, hop, __ATOMIC_RELEASE);
+		} else {
+			wait_hop(&pair->line, hop);
+			for (w=0 ; w<PAYLOAD_WORDS ; w++) {
+				const uint64_t got = pair->line.payload[w];
+				if (got != payload_word(hop, w)) {
+					if (!err->count++) {
+						err->hop = hop;
+						err->word = w;
+						err->expected = payload_word(hop, w);
+						err->got = got;
+					}
+				}
+			}
+		}
+	}
+
+	if (!side->idx) {
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		pair->ns = ((end.tv_sec-start.tv_sec)*1e9 + (end.tv_nsec-start.tv_nsec)) / pair->roundtrips;
+	}
+
+	return NULL;
+}
+
+static int run_pair(struct pair * const pair, const int cpua, const int cpub, const unsigned long int roundtrips)
+{
+	struct side sides[2];
+	unsigned int i;
+
+	memset(pair, 0, sizeof(*pair));
+	pair->cpus[0] = cpua;
+	pair->cpus[1] = cpub;
+	pair->roundtrips = roundtrips;
+
+	for (i=0 ; i<2 ; i++) {
+		sides[i].pair = pair;
+		sides[i].idx = i;
+		if (pthread_create(&sides[i].thread, NULL, side_func, &sides[i])) {
+			fprintf(stderr, "Issue when spawning thread\n");
+			if (i) {
+				__atomic_store_n(&pair->aborted, 1, __ATOMIC_RELEASE);
+				pthread_join(sides[0].thread, NULL);
+			}
+			return -1;
+		}
+	}
+
+	for (i=0 ; i<2 ; i++)
+		pthread_join(sides[i].thread, NULL);
+
+	return 0;
+}
+
+static int double_cmp(void const *a, void const *b)
+{
+	double const da = *(double const *)a, db = *(double const *)b;
+
+	return da < db ? -1 : da > db;
+}
+
+/* Sorts values */
+static double median(double * const values, const size_t n)
+{
+	qsort(values, n, sizeof(*values), double_cmp);
+	return n%2 ? values[n/2] : (values[n/2-1]+values[n/2])/2;
+}
+
+enum topo_class {
+	CLASS_SAME_CORE,
+	CLASS_SAME_PACKAGE,
+	CLASS_CROSS_PACKAGE,
+	CLASS_COUNT
+};
+
+static char const * const class_names[CLASS_COUNT] = {
+	"same core",
+	"same package",
+	"cross package",
+};
+
+static enum topo_class pair_class(struct cpu_topo const * const a, struct cpu_topo const * const b)
+{
+	if (topology_same_core(a, b))
+		return CLASS_SAME_CORE;
+	if (topology_same_package(a, b))
+		return CLASS_SAME_PACKAGE;
+	return CLASS_CROSS_PACKAGE;
+}
+
+static void print_matrix(FILE *out, struct cpu_topo const * const cpus, const unsigned int count, double const * const matrix)
+{
+	unsigned int i, j;
+
+	fprintf(out, "cpu");
+	for (j=0 ; j<count ; j++)
+		fprintf(out, ",%d", cpus[j].cpu);
+	fprintf(out, "\n");
+
+	for (i=0 ; i<count ; i++) {
+		fprintf(out, "%d", cpus[i].cpu);
+		for (j=0 ; j<count ; j++) {
+			if (i == j || isnan(matrix[i*count+j]))
+				fprintf(out, ",");
+			else
+				fprintf(out, ",%.1f", matrix[i*count+j]);
+		}
+		fprintf(out, "\n");
+	}
+}
+
+static int print_outliers(FILE *out, struct cpu_topo const * const cpus, const unsigned int count, double const * const matrix)
+{
+	double *values, med[CLASS_COUNT], mad[CLASS_COUNT];
+	size_t n;
+	unsigned int i, j, outliers = 0;
+	enum topo_class cls;
+
+	values = malloc(sizeof(*values) * count * count);
+	if (!values) {
+		fprintf(stderr, "Could not allocate outliers detection buffer\n");
+		return -1;
+	}
+
+	for (cls=0 ; cls<CLASS_COUNT ; cls++) {
+		for (n=0, i=0 ; i<count ; i++)
+			for (j=i+1 ; j<count ; j++)
+				if (pair_class(&cpus[i], &cpus[j]) == cls && !isnan(matrix[i*count+j]))
+					values[n++] = matrix[i*count+j];
+
+		if (!n) {
+			med[cls] = mad[cls] = NAN;
+			continue;
+		}
+
+		med[cls] = median(values, n);
+		for (i=0 ; i<n ; i++)
+			values[i] = fabs(values[i]-med[cls]);
+		mad[cls] = median(values, n);
+
+		fprintf(out, "# %s: %zu pairs, median %.1f ns, MAD %.1f ns\n", class_names[cls], n, med[cls], mad[cls]);
+	}
+
+	for (i=0 ; i<count ; i++) {
+		for (j=i+1 ; j<count ; j++) {
+			const double v = matrix[i*count+j];
+
+			cls = pair_class(&cpus[i], &cpus[j]);
+			if (isnan(v) || v < med[cls]*OUTLIER_RATIO || v < med[cls]+OUTLIER_MADS*mad[cls])
+				continue;
+			fprintf(out, "# outlier: cpu %d <-> cpu %d: %.1f ns (%s median %.1f ns)\n",
+					cpus[i].cpu, cpus[j].cpu, v, class_names[cls], med[cls]);
+			outliers++;
+		}
+	}
+	fprintf(out, "# %u outlier pairs\n", outliers);
+
+	free(values);
+	return 0;
+}
+
+long int c2c_run(FILE *out, struct cpu_topo const * const cpus, const unsigned int count,
+		const unsigned long int roundtrips, volatile int const * const should_stop)
+{
+	struct pair pair;
+	double *matrix;
+	unsigned int i, j, k;
+	long int inconsistencies = 0;
+
+	if (count < 2) {
+		fprintf(stderr, "Core to core latency needs at least two cpus\n");
+		return -1;
+	}
+	if (!roundtrips) {
+		fprintf(stderr, "Needs a non-null round-trip count\n");
+		return -1;
+	}
+
+	matrix = malloc(sizeof(*matrix) * count * count);
+	if (!matrix) {
+		fprintf(stderr, "Could not allocate latency matrix\n");
+		return -1;
+	}
+	for (i=0 ; i<count*count ; i++)
+		matrix[i] = NAN;
+
+	for (i=0 ; i<count && !*should_stop ; i++) {
+		for (j=i+1 ; j<count && !*should_stop ; j++) {
+			if (run_pair(&pair, cpus[i].cpu, cpus[j].cpu, roundtrips)) {
+				free(matrix);
+				return -1;
+			}
+			if (pair.pin_failed)
+				fprintf(stderr, "Could not pin threads on cpus %d and %d, latency is meaningless\n",
+						cpus[i].cpu, cpus[j].cpu);
+			for (k=0 ; k<2 ; k++) {
+				struct side_error const * const err = &pair.errors[k];
+
+				if (!err->count)
+					continue;
+				fprintf(stderr, "Inconsistency detected...\n");
+				fprintf(stderr, "cpu %d reading from cpu %d: %lu corrupted words, first at hop %" PRIu64
+						", word %zu: expected=0x%" PRIx64 ", got=0x%" PRIx64 "\n",
+						pair.cpus[k], pair.cpus[!k], err->count, err->hop, err->word, err->expected, err->got);
+				inconsistencies += err->count;
+			}
+			matrix[i*count+j] = matrix[j*count+i] = pair.ns;
+		}
+	}
+
+	print_matrix(out, cpus, count, matrix);
+	if (print_outliers(out, cpus, count, matrix))
+		inconsistencies = -1;
+
+	free(matrix);
+
+	return inconsistencies;
+}
@@ -0,0 +1,29 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#ifndef C2C_H
+#define C2C_H
+
+#include <stdio.h>
+#include "topology.h"
+
+/* Measures the cache line round-trip latency between every pair of cpus,
+ * prints the matrix as CSV followed by an outliers summary on out.
+ * Returns the number of payload inconsistencies, or -1 on error. */
+long int c2c_run(FILE *out, struct cpu_topo const * const cpus, const unsigned int count,
+		const unsigned long int roundtrips, volatile int const * const should_stop);
+
+#endif
@@ -21,7 +21,6 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <inttypes.h>
-#include <time.h>
 #include "cpucheck.h"
 
 struct elt {
@@ -44,10 +43,8 @@ static int init(void * const config, void * const table, const size_t table_size
 	uint64_t j;
 	struct elt * const elts = table;
 
-	srandom(time(NULL));
-
 	for(i=0 ; i<table_size ; i++) {
-		elts[i].a = u64random();
+		elts[i].a = cpucheck_u64random();
 		elts[i].zero = !elts[i].a;
 		if (!elts[i].zero) {
 			for(j=0 ; !((elts[i].a >> j) & 1) ; j++) ;
@@ -94,7 +91,19 @@ static void report_error(FILE *out, void const * const config, void const * cons
 	fprintf(out, "Found bit set, by right: %s, by left: %s", c->rz?"false":"true", c->lz?"false":"true");
 }
 
-CPUCHECK_CHECKER(bitscan, "Performs bit scanning (bsf/bsr)", 0, sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, NULL)
+static struct cpucheck_field const expected[] = {
+	CPUCHECK_FIELD(struct elt, ri),
+	CPUCHECK_FIELD(struct elt, li),
+	{ NULL, 0, 0 }
+};
+
+static struct cpucheck_output const outputs[] = {
+	CPUCHECK_OUTPUT(struct elt, ri, struct comp, ri),
+	CPUCHECK_OUTPUT(struct elt, li, struct comp, li),
+	{ NULL, 0, 0, 0, NULL }
+};
+
+CPUCHECK_CHECKER_OUTPUTS(bitscan, "Performs bit scanning (bsf/bsr)", 0, sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, NULL, expected, NULL, outputs)
 
 #endif /* ARCH_X86_64 */
 
@@ -21,7 +21,6 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <inttypes.h>
-#include <time.h>
 #include "cpucheck.h"
 
 #define TEST_COUNT 8
@@ -53,54 +52,60 @@ struct comp {
 	struct comp_bt res[TEST_COUNT];
 };
 
+static void fill_test(struct bt * const t, const uint64_t a, const uint64_t bit_index)
+{
+	t->bit_index = bit_index;
+	t->set = !! (a & 1ULL<<bit_index);
+	t->toggled = a ^ 1ULL<<bit_index;
+	t->cleared = a & ~(1ULL<<bit_index);
+	t->set_ts = a | 1ULL<<bit_index;
+}
+
 static int init(void * const config, void * const table, const size_t table_size)
 {
 	size_t i, j;
 	struct elt * const elts = table;
 
-	srandom(time(NULL));
-
 	for(i=0 ; i<table_size ; i++) {
-		elts[i].a = u64random();
-		for(j=0 ; j<sizeof(elts[i].tests)/sizeof(elts[i].tests[0]) ; j++) {
-			elts[i].tests[j].bit_index = random()%64;
-			elts[i].tests[j].set = !! (elts[i].a & 1ULL<<elts[i].tests[j].bit_index);
-			elts[i].tests[j].toggled = elts[i].a ^ 1ULL<<elts[i].tests[j].bit_index;
-			elts[i].tests[j].cleared = elts[i].a & ~(1ULL<<elts[i].tests[j].bit_index);
-			elts[i].tests[j].set_ts = elts[i].a | 1ULL<<elts[i].tests[j].bit_index;
-		}
+		elts[i].a = cpucheck_u64random();
+		for(j=0 ; j<sizeof(elts[i].tests)/sizeof(elts[i].tests[0]) ; j++)
+			fill_test(&elts[i].tests[j], elts[i].a, random()%64);
 	}
 
 	return 0;
 }
 
+static inline void bt(struct comp_bt * const r, const uint64_t a, const uint64_t bit_index)
+{
+	asm("btq %[bidx], %[a] \n\t"
+		"setcb %[set_t] \n\t"
+		"movq %[a], %[res_tc] \n\t"
+		"btcq %[bidx], %[res_tc] \n\t"
+		"setcb %[set_tc] \n\t"
+		"movq %[a], %[res_tr] \n\t"
+		"btrq %[bidx], %[res_tr] \n\t"
+		"setcb %[set_tr] \n\t"
+		"movq %[a], %[res_ts] \n\t"
+		"btsq %[bidx], %[res_ts] \n\t"
+		"setcb %[set_ts] \n\t"
+	: [set_t] "=&r" (r->set_t),
+	  [set_tc] "=&r" (r->set_tc), [res_tc] "=&r" (r->res_tc),
+	  [set_tr] "=&r" (r->set_tr), [res_tr] "=&r" (r->res_tr),
+	  [set_ts] "=&r" (r->set_ts), [res_ts] "=&r" (r->res_ts)
+	: [a] "mr" (a),
+	  [bidx] "r" (bit_index)
+	: "cc"
+	);
+}
+
 static int check_item(void * const comp, void const * const config, void const * const table_element)
 {
 	struct elt const * const elt = table_element;
 	struct comp * const c = comp;
 	size_t j;
 
-	for(j=0 ; j<sizeof(elt->tests)/sizeof(elt->tests[0]) ; j++) {
-		asm("btq %[bidx], %[a] \n\t"
-			"setcb %[set_t] \n\t"
-			"movq %[a], %[res_tc] \n\t"
-			"btcq %[bidx], %[res_tc] \n\t"
-			"setcb %[set_tc] \n\t"
-			"movq %[a], %[res_tr] \n\t"
-			"btrq %[bidx], %[res_tr] \n\t"
-			"setcb %[set_tr] \n\t"
-			"movq %[a], %[res_ts] \n\t"
-			"btsq %[bidx], %[res_ts] \n\t"
-			"setcb %[set_ts] \n\t"
-		: [set_t] "=&r" (c->res[j].set_t),
-		  [set_tc] "=&r" (c->res[j].set_tc), [res_tc] "=&r" (c->res[j].res_tc),
-		  [set_tr] "=&r" (c->res[j].set_tr), [res_tr] "=&r" (c->res[j].res_tr),
-		  [set_ts] "=&r" (c->res[j].set_ts), [res_ts] "=&r" (c->res[j].res_ts)
-		: [a] "mr" (elt->a),
-		  [bidx] "r" (elt->tests[j].bit_index)
-		: "cc"
-		);
-	}
+	for(j=0 ; j<sizeof(elt->tests)/sizeof(elt->tests[0]) ; j++)
+		bt(&c->res[j], elt->a, elt->tests[j].bit_index);
 
 	for(j=0 ; j<sizeof(elt->tests)/sizeof(elt->tests[0]) ; j++) {
 		if (c->res[j].set_t != elt->tests[j].set
@@ -138,6 +143,107 @@ static void report_error(FILE *out, void const * const config, void const * cons
 	}
 }
 
-CPUCHECK_CHECKER(bittest, "Performs bit testing (bt, btc, btr, bts)", 0, sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, NULL)
+/* Compact layout, expected results are folded in digest */
+struct compact_elt {
+	uint64_t a;
+	uint8_t bit_index[TEST_COUNT];
+	uint64_t digest;
+};
+
+static uint64_t digest(struct comp const * const c)
+{
+	uint64_t h = 0;
+	size_t j;
+
+	for(j=0 ; j<TEST_COUNT ; j++) {
+		h = cpucheck_digest(h, c->res[j].set_t);
+		h = cpucheck_digest(h, c->res[j].set_tc);
+		h = cpucheck_digest(h, c->res[j].set_tr);
+		h = cpucheck_digest(h, c->res[j].set_ts);
+		h = cpucheck_digest(h, c->res[j].res_tc);
+		h = cpucheck_digest(h, c->res[j].res_tr);
+		h = cpucheck_digest(h, c->res[j].res_ts);
+	}
+
+	return h;
+}
+
+static void expand(struct elt * const elt, struct compact_elt const * const celt)
+{
+	size_t j;
+
+	elt->a = celt->a;
+	for(j=0 ; j<TEST_COUNT ; j++)
+		fill_test(&elt->tests[j], celt->a, celt->bit_index[j]);
+}
+
+static int init_compact(void * const config, void * const table, const size_t table_size)
+{
+	struct compact_elt * const celts = table;
+	struct elt elt;
+	struct comp expected;
+	size_t i, j;
+
+	for(i=0 ; i<table_size ; i++) {
+		celts[i].a = cpucheck_u64random();
+		for(j=0 ; j<TEST_COUNT ; j++)
+			celts[i].bit_index[j] = random()%64;
+
+		expand(&elt, &celts[i]);
+		for(j=0 ; j<TEST_COUNT ; j++) {
+			expected.res[j].set_t = expected.res[j].set_tc = elt.tests[j].set;
+			expected.res[j].set_tr = expected.res[j].set_ts = elt.tests[j].set;
+			expected.res[j].res_tc = elt.tests[j].toggled;
+			expected.res[j].res_tr = elt.tests[j].cleared;
+			expected.res[j].res_ts = elt.tests[j].set_ts;
+		}
+		celts[i].digest = digest(&expected);
+	}
+
+	return 0;
+}
+
+static int check_compact(void * const comp, void const * const config, void const * const table_element)
+{
+	struct compact_elt const * const celt = table_element;
+	struct comp * const c = comp;
+	size_t j;
+
+	for(j=0 ; j<TEST_COUNT ; j++)
+		bt(&c->res[j], celt->a, celt->bit_index[j]);
+
+	return digest(c) != celt->digest;
+}
+
+static void report_compact(FILE *out, void const * const config, void const * const table_element, void const * const comp)
+{
+	struct compact_elt const * const celt = table_element;
+	struct elt elt;
+
+	fprintf(out, "digest, expected=%" PRIx64 ", got=%" PRIx64 "\n", celt->digest, digest(comp));
+	expand(&elt, celt);
+	report_error(out, config, &elt, comp);
+}
+
+static struct cpucheck_field const compact_expected[] = {
+	CPUCHECK_FIELD(struct compact_elt, digest),
+	{ NULL, 0, 0 }
+};
+
+#define BT_OUTPUTS(i) \
+	CPUCHECK_OUTPUT(struct elt, tests[i].toggled, struct comp, res[i].res_tc), \
+	CPUCHECK_OUTPUT(struct elt, tests[i].cleared, struct comp, res[i].res_tr), \
+	CPUCHECK_OUTPUT(struct elt, tests[i].set_ts, struct comp, res[i].res_ts)
+
+/* One row per test, TEST_COUNT of them */
+static struct cpucheck_output const outputs[] = {
+	BT_OUTPUTS(0), BT_OUTPUTS(1), BT_OUTPUTS(2), BT_OUTPUTS(3),
+	BT_OUTPUTS(4), BT_OUTPUTS(5), BT_OUTPUTS(6), BT_OUTPUTS(7),
+	{ NULL, 0, 0, 0, NULL }
+};
+#undef BT_OUTPUTS
+
+CPUCHECK_CHECKER_EXPECTED(bittest_compact, "Performs bit testing (bt, btc, btr, bts), compact table", 0, sizeof(struct compact_elt), sizeof(struct comp), init_compact, check_compact, report_compact, NULL, compact_expected)
+CPUCHECK_CHECKER_OUTPUTS(bittest, "Performs bit testing (bt, btc, btr, bts)", 0, sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, NULL, NULL, &cpucheck_checker_bittest_compact, outputs)
 
 #endif
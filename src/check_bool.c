@@ -18,7 +18,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <inttypes.h>
-#include <time.h>
+#include <stddef.h>
 #include "cpucheck.h"
 
 struct elt {
@@ -37,16 +37,93 @@ struct comp {
 	uint64_t nota;
 };
 
+enum kernel {
+	/* General purpose registers */
+	KERNEL_GPR,
+	/* 256 bits AVX2 lanes, one per operation, blended */
+	KERNEL_AVX2,
+	/* 256 bits AVX-512VL lanes, each computed by a masked vpternlogq */
+	KERNEL_AVX512,
+};
+
+struct config {
+	enum kernel kernel;
+};
+
+#if ARCH_X86_64
+static void cpuid(const uint32_t leaf, uint32_t * const eax, uint32_t * const ebx, uint32_t * const ecx)
+{
+	asm("cpuid \n\t"
+		: "=a" (*eax), "=b" (*ebx), "=c" (*ecx)
+		: "a" (leaf), "c" (0)
+		: "edx"
+	);
+}
+
+/* Picks the widest vector kernel the cpu has and the kernel saves the state
+ * of */
+static enum kernel pick_kernel(void)
+{
+	uint32_t max, ebx, ecx, xcr0, dummy;
+
+	cpuid(0, &max, &dummy, &dummy);
+	if (max < 7)
+		return KERNEL_GPR;
+	cpuid(1, &dummy, &dummy, &ecx);
+	/* osxsave and avx */
+	if ((ecx & (1<<27 | 1<<28)) != (1<<27 | 1<<28))
+		return KERNEL_GPR;
+	asm("xgetbv \n\t"
+		: "=a" (xcr0)
+		: "c" (0)
+		: "edx"
+	);
+	/* sse and avx states */
+	if ((xcr0 & 0x6) != 0x6)
+		return KERNEL_GPR;
+
+	cpuid(7, &dummy, &ebx, &ecx);
+	/* avx512f, avx512vl, and opmask, zmm0-15 and zmm16-31 upper halves
+	 * states */
+	if ((ebx & (1<<16 | 1u<<31)) == (1<<16 | 1u<<31) && (xcr0 & 0xe0) == 0xe0)
+		return KERNEL_AVX512;
+	/* avx2 */
+	if (ebx & 1<<5)
+		return KERNEL_AVX2;
+
+	return KERNEL_GPR;
+}
+#endif
+
+static char const * kernel_name(void const * const config)
+{
+	struct config const * const cfg = config;
+
+	switch (cfg->kernel) {
+		case KERNEL_AVX2:
+			return "avx2";
+		case KERNEL_AVX512:
+			return "avx512vl";
+		default:
+			return "general purpose registers";
+	}
+}
+
 static int init(void * const config, void * const table, const size_t table_size)
 {
+	struct config * const cfg = config;
 	size_t i;
 	struct elt * const elts = table;
 
-	srandom(time(NULL));
+#if ARCH_X86_64
+	cfg->kernel = pick_kernel();
+#else
+	cfg->kernel = KERNEL_GPR;
+#endif
 
 	for(i=0 ; i<table_size ; i++) {
-		elts[i].a = u64random();
-		elts[i].b = u64random();
+		elts[i].a = cpucheck_u64random();
+		elts[i].b = cpucheck_u64random();
 		elts[i].and = elts[i].a & elts[i].b;
 		elts[i].or = elts[i].a | elts[i].b;
 		elts[i].xor = elts[i].a ^ elts[i].b;
@@ -56,11 +133,89 @@ static int init(void * const config, void * const table, const size_t table_size
 	return 0;
 }
 
+#if ARCH_X86_64
+/* Expected results are laid out as comp in elements, so that they are compared
+ * with a single vector */
+#define EXPECTED_OFFSET offsetof(struct elt, and)
+
+static int check_avx2(struct comp * const c, struct elt const * const elt)
+{
+	uint32_t eq;
+
+	asm volatile("vpbroadcastq %c[a](%[elt]), %%ymm0 \n\t"
+		"vpbroadcastq %c[b](%[elt]), %%ymm1 \n\t"
+		"vpand %%ymm1, %%ymm0, %%ymm2 \n\t"
+		"vpor %%ymm1, %%ymm0, %%ymm3 \n\t"
+		"vpxor %%ymm1, %%ymm0, %%ymm4 \n\t"
+		"vpcmpeqq %%ymm5, %%ymm5, %%ymm5 \n\t"
+		"vpxor %%ymm5, %%ymm0, %%ymm5 \n\t"
+		"vpblendd $0x0c, %%ymm3, %%ymm2, %%ymm2 \n\t"
+		"vpblendd $0x30, %%ymm4, %%ymm2, %%ymm2 \n\t"
+		"vpblendd $0xc0, %%ymm5, %%ymm2, %%ymm2 \n\t"
+		"vmovdqu %%ymm2, (%[c]) \n\t"
+		"vpcmpeqq %c[e](%[elt]), %%ymm2, %%ymm2 \n\t"
+		"vmovmskpd %%ymm2, %[eq] \n\t"
+		"vzeroupper \n\t"
+		: [eq] "=r" (eq)
+		: [elt] "r" (elt), [c] "r" (c),
+			[a] "i" (offsetof(struct elt, a)), [b] "i" (offsetof(struct elt, b)), [e] "i" (EXPECTED_OFFSET)
+		: "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "memory"
+	);
+
+	return eq != 0xf;
+}
+
+/* vpternlogq truth tables, with a in the destination and b in both sources */
+#define TERNLOG_AND 0xc0
+#define TERNLOG_OR 0xfc
+#define TERNLOG_XOR 0x3c
+#define TERNLOG_NOTA 0x0f
+
+/* The target lets the asm clobber an opmask register */
+__attribute__((target("avx512f"))) static int check_avx512(struct comp * const c, struct elt const * const elt)
+{
+	uint32_t ne;
+
+	asm volatile("vpbroadcastq %c[a](%[elt]), %%ymm0 \n\t"
+		"vpbroadcastq %c[b](%[elt]), %%ymm1 \n\t"
+		"movl $1, %[ne] \n\t"
+		"kmovw %[ne], %%k1 \n\t"
+		"vpternlogq %[and], %%ymm1, %%ymm1, %%ymm0%{%%k1%} \n\t"
+		"kshiftlw $1, %%k1, %%k1 \n\t"
+		"vpternlogq %[or], %%ymm1, %%ymm1, %%ymm0%{%%k1%} \n\t"
+		"kshiftlw $1, %%k1, %%k1 \n\t"
+		"vpternlogq %[xor], %%ymm1, %%ymm1, %%ymm0%{%%k1%} \n\t"
+		"kshiftlw $1, %%k1, %%k1 \n\t"
+		"vpternlogq %[nota], %%ymm1, %%ymm1, %%ymm0%{%%k1%} \n\t"
+		"vmovdqu64 %%ymm0, (%[c]) \n\t"
+		"vpcmpneqq %c[e](%[elt]), %%ymm0, %%k1 \n\t"
+		"kmovw %%k1, %[ne] \n\t"
+		"vzeroupper \n\t"
+		: [ne] "=&r" (ne)
+		: [elt] "r" (elt), [c] "r" (c),
+			[a] "i" (offsetof(struct elt, a)), [b] "i" (offsetof(struct elt, b)), [e] "i" (EXPECTED_OFFSET),
+			[and] "i" (TERNLOG_AND), [or] "i" (TERNLOG_OR), [xor] "i" (TERNLOG_XOR), [nota] "i" (TERNLOG_NOTA)
+		: "xmm0", "xmm1", "k1", "memory"
+	);
+
+	return ne != 0;
+}
+#endif
+
 static int check_item(void * const comp, void const * const config, void const * const table_element)
 {
 	struct elt const * const elt = table_element;
 	struct comp * const c = comp;
 
+#if ARCH_X86_64
+	struct config const * const cfg = config;
+
+	if (cfg->kernel == KERNEL_AVX512)
+		return check_avx512(c, elt);
+	if (cfg->kernel == KERNEL_AVX2)
+		return check_avx2(c, elt);
+#endif
+
 	c->and = elt->a & elt->b;
 	c->or = elt->a | elt->b;
 	c->xor = elt->a ^ elt->b;
@@ -77,6 +232,7 @@ static void report_error(FILE *out, void const * const config, void const * cons
 	struct elt const * const elt = table_element;
 	struct comp const * const c = comp;
 
+	fprintf(out, "Computed with %s\n", kernel_name(config));
 	fprintf(out, "a=0x%" PRIx64 ", b=0x%" PRIx64 "\n", elt->a, elt->b);
 	fprintf(out, "and: expected=0x%" PRIx64 ", got=0x%" PRIx64 "\n", elt->and, c->and);
 	fprintf(out, "or: expected=0x%" PRIx64 ", got=0x%" PRIx64 "\n", elt->or, c->or);
@@ -84,5 +240,21 @@ static void report_error(FILE *out, void const * const config, void const * cons
 	fprintf(out, "not a: expected=0x%" PRIx64 ", got=0x%" PRIx64 "\n", elt->nota, c->nota);
 }
 
-CPUCHECK_CHECKER(bool, "Performs boolean and, or, xor, and not", 0, sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, NULL)
+static struct cpucheck_field const expected[] = {
+	CPUCHECK_FIELD(struct elt, and),
+	CPUCHECK_FIELD(struct elt, or),
+	CPUCHECK_FIELD(struct elt, xor),
+	CPUCHECK_FIELD(struct elt, nota),
+	{ NULL, 0, 0 }
+};
+
+static struct cpucheck_output const outputs[] = {
+	CPUCHECK_OUTPUT(struct elt, and, struct comp, and),
+	CPUCHECK_OUTPUT(struct elt, or, struct comp, or),
+	CPUCHECK_OUTPUT(struct elt, xor, struct comp, xor),
+	CPUCHECK_OUTPUT(struct elt, nota, struct comp, nota),
+	{ NULL, 0, 0, 0, NULL }
+};
+
+CPUCHECK_CHECKER_KERNEL(bool, "Performs boolean and, or, xor, and not", sizeof(struct config), sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, NULL, expected, NULL, outputs, kernel_name)
 
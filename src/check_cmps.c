@@ -19,7 +19,8 @@
 #if ARCH_X86_64
 
 #include <stdlib.h>
-#include <time.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include "cpucheck.h"
 
 #define MISMATCH_COUNT 5
@@ -77,35 +78,42 @@ static void introduce_mismatches(struct elt * const elt)
 	}
 }
 
+static int fill(struct elt * const elt)
+{
+	size_t j;
+
+	elt->len = random()%MAXSTRLEN;
+	if (! (elt->a = malloc(elt->len)))
+		return -1;
+	if (! (elt->b = malloc(elt->len))) {
+		free(elt->a);
+		return -1;
+	}
+
+	for(j=0 ; j<elt->len ; j++)
+		elt->a[j] = elt->b[j] = random();
+
+	introduce_mismatches(elt);
+
+	fill_mismatch(elt->mismatch_byte, elt, 1);
+	fill_mismatch(elt->mismatch_word, elt, 2);
+	fill_mismatch(elt->mismatch_double, elt, 4);
+	fill_mismatch(elt->mismatch_quad, elt, 8);
+
+	return 0;
+}
+
 static int init(void * const config, void * const table, const size_t table_size)
 {
 	size_t i, j;
 	struct elt * const elts = table;
 	int r;
 
-	srandom(time(NULL));
-
 	for(i=0 ; i<table_size ; i++) {
-		elts[i].len = random()%MAXSTRLEN;
-		if (! (elts[i].a = malloc(elts[i].len))) {
-			r = -1;
-			goto err;
-		}
-		if (! (elts[i].b = malloc(elts[i].len))) {
-			free(elts[i].a);
+		if (fill(&elts[i])) {
 			r = -1;
 			goto err;
 		}
-
-		for(j=0 ; j<elts[i].len ; j++)
-			elts[i].a[j] = elts[i].b[j] = random();
-
-		introduce_mismatches(&elts[i]);
-
-		fill_mismatch(elts[i].mismatch_byte, &elts[i], 1);
-		fill_mismatch(elts[i].mismatch_word, &elts[i], 2);
-		fill_mismatch(elts[i].mismatch_double, &elts[i], 4);
-		fill_mismatch(elts[i].mismatch_quad, &elts[i], 8);
 	}
 
 	return 0;
@@ -175,7 +183,6 @@ static int check_item(void * const comp, void const * const config, void const *
 
 	return 0;
 }
-#undef COMP_MISMATCH
 
 #define PRINT_MM(arg_what, arg_mm_expected, arg_mm_got) do { \
 	size_t i; \
@@ -191,8 +198,8 @@ static void report_error(FILE *out, void const * const config, void const * cons
 	struct elt const * const elt = table_element;
 	struct comp const * const c = comp;
 
-	hex_dump(out, "a=", elt->a, elt->len);
-	hex_dump(out, "b=", elt->b, elt->len);
+	cpucheck_hex_dump(out, "a=", elt->a, elt->len);
+	cpucheck_hex_dump(out, "b=", elt->b, elt->len);
 
 	PRINT_MM("byte", elt->mismatch_byte, c->mismatch_byte)
 	PRINT_MM("word", elt->mismatch_word, c->mismatch_word)
@@ -213,6 +220,110 @@ static void delete(void * const config, void * const table, const size_t table_s
 	}
 }
 
-CPUCHECK_CHECKER(cmps, "Performs string comparisons on different word sizes (cmpsb, cmpsw, cmpsd, cmpsq)", 0, sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, delete)
+/* Compact layout, expected results are folded in digest */
+struct compact_elt {
+	size_t len;
+	char *a;
+	char *b;
+	uint64_t digest;
+};
+
+static uint64_t digest(struct comp const * const c)
+{
+	uint64_t h = 0;
+	size_t i;
+
+	for(i=0 ; i<MISMATCH_COUNT ; i++) {
+		h = cpucheck_digest(h, c->mismatch_byte[i]);
+		h = cpucheck_digest(h, c->mismatch_word[i]);
+		h = cpucheck_digest(h, c->mismatch_double[i]);
+		h = cpucheck_digest(h, c->mismatch_quad[i]);
+	}
+
+	return cpucheck_digest(h, c->too_much);
+}
+
+static int init_compact(void * const config, void * const table, const size_t table_size)
+{
+	struct compact_elt * const celts = table;
+	struct elt elt;
+	struct comp expected;
+	size_t i, j;
+
+	for(i=0 ; i<table_size ; i++) {
+		if (fill(&elt)) {
+			for(j=0 ; j<i ; j++) {
+				free(celts[j].a);
+				free(celts[j].b);
+			}
+			return -1;
+		}
+		celts[i].len = elt.len;
+		celts[i].a = elt.a;
+		celts[i].b = elt.b;
+
+		for(j=0 ; j<MISMATCH_COUNT ; j++) {
+			expected.mismatch_byte[j] = elt.mismatch_byte[j];
+			expected.mismatch_word[j] = elt.mismatch_word[j];
+			expected.mismatch_double[j] = elt.mismatch_double[j];
+			expected.mismatch_quad[j] = elt.mismatch_quad[j];
+		}
+		expected.too_much = 0;
+		celts[i].digest = digest(&expected);
+	}
+
+	return 0;
+}
+
+static int check_compact(void * const comp, void const * const config, void const * const table_element)
+{
+	struct compact_elt const * const elt = table_element;
+	struct comp * const c = comp;
+
+	c->too_much = 0;
+
+	COMP_MISMATCH(c->mismatch_byte, 1, "cmpsb")
+	COMP_MISMATCH(c->mismatch_word, 2, "cmpsw")
+	COMP_MISMATCH(c->mismatch_double, 4, "cmpsd")
+	COMP_MISMATCH(c->mismatch_quad, 8, "cmpsq")
+
+	return digest(c) != elt->digest;
+}
+#undef COMP_MISMATCH
+
+static void report_compact(FILE *out, void const * const config, void const * const table_element, void const * const comp)
+{
+	struct compact_elt const * const celt = table_element;
+	struct elt elt;
+
+	fprintf(out, "digest, expected=0x%" PRIx64 ", got=0x%" PRIx64 "\n", celt->digest, digest(comp));
+	elt.len = celt->len;
+	elt.a = celt->a;
+	elt.b = celt->b;
+	fill_mismatch(elt.mismatch_byte, &elt, 1);
+	fill_mismatch(elt.mismatch_word, &elt, 2);
+	fill_mismatch(elt.mismatch_double, &elt, 4);
+	fill_mismatch(elt.mismatch_quad, &elt, 8);
+	report_error(out, config, &elt, comp);
+}
+
+static void delete_compact(void * const config, void * const table, const size_t table_size)
+{
+	struct compact_elt * const celts = table;
+	size_t i;
+
+	for (i=0 ; i<table_size ; i++) {
+		free(celts[i].a);
+		free(celts[i].b);
+	}
+}
+
+static struct cpucheck_field const compact_expected[] = {
+	CPUCHECK_FIELD(struct compact_elt, digest),
+	{ NULL, 0, 0 }
+};
+
+CPUCHECK_CHECKER_EXPECTED(cmps_compact, "Performs string comparisons on different word sizes (cmpsb, cmpsw, cmpsd, cmpsq), compact table", 0, sizeof(struct compact_elt), sizeof(struct comp), init_compact, check_compact, report_compact, delete_compact, compact_expected)
+CPUCHECK_CHECKER_COMPACT(cmps, "Performs string comparisons on different word sizes (cmpsb, cmpsw, cmpsd, cmpsq)", 0, sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, delete, NULL, &cpucheck_checker_cmps_compact)
 
 #endif	/* ARCH_X86_64 */
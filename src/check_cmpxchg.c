@@ -20,7 +20,6 @@
 
 #include <stdlib.h>
 #include <inttypes.h>
-#include <time.h>
 #include "cpucheck.h"
 
 struct cmpxchg {
@@ -116,9 +115,9 @@ static void init_config(struct config * const cfg)
 
 static void init_cmpxchg(struct cmpxchg * const elt)
 {
-	elt->a = u64random();
-	elt->b = random()%2 ? elt->a : u64random();
-	elt->c = u64random();
+	elt->a = cpucheck_u64random();
+	elt->b = random()%2 ? elt->a : cpucheck_u64random();
+	elt->c = cpucheck_u64random();
 	elt->zf = elt->a == elt->b;
 	elt->res_m = elt->zf ? elt->c : elt->b;
 	elt->res_rax = elt->zf ? elt->a : elt->b;
@@ -126,11 +125,11 @@ static void init_cmpxchg(struct cmpxchg * const elt)
 
 static void init_cmpxchg8b(struct cmpxchg8b * const elt)
 {
-	elt->ahi = u64random();
-	elt->alo = u64random();
-	elt->b = random()%2 ? (uint64_t)elt->ahi<<32|elt->alo : u64random();
-	elt->chi = u64random();
-	elt->clo = u64random();
+	elt->ahi = cpucheck_u64random();
+	elt->alo = cpucheck_u64random();
+	elt->b = random()%2 ? (uint64_t)elt->ahi<<32|elt->alo : cpucheck_u64random();
+	elt->chi = cpucheck_u64random();
+	elt->clo = cpucheck_u64random();
 	elt->zf = ((uint64_t)elt->ahi<<32|elt->alo) == elt->b;
 	elt->edx = elt->zf ? elt->ahi : elt->b>>32;
 	elt->eax = elt->zf ? elt->alo : elt->b;
@@ -139,17 +138,17 @@ static void init_cmpxchg8b(struct cmpxchg8b * const elt)
 
 static void init_cmpxchg16b(struct cmpxchg16b * const elt)
 {
-	elt->ahi = u64random();
-	elt->alo = u64random();
+	elt->ahi = cpucheck_u64random();
+	elt->alo = cpucheck_u64random();
 	if (random()%2) {
-		elt->bhi = u64random();
-		elt->blo = u64random();
+		elt->bhi = cpucheck_u64random();
+		elt->blo = cpucheck_u64random();
 	} else {
 		elt->bhi = elt->ahi;
 		elt->blo = elt->alo;
 	}
-	elt->chi = u64random();
-	elt->clo = u64random();
+	elt->chi = cpucheck_u64random();
+	elt->clo = cpucheck_u64random();
 	elt->zf = elt->ahi == elt->bhi && elt->alo == elt->blo;
 	elt->rdx = elt->zf ? elt->ahi : elt->bhi;
 	elt->rax = elt->zf ? elt->alo : elt->blo;
@@ -165,8 +164,6 @@ static int init(void * const config, void * const table, const size_t table_size
 
 	init_config(cfg);
 
-	srandom(time(NULL));
-
 	for(i=0 ; i<table_size ; i++) {
 		init_cmpxchg(&elts[i].cmpxchg);
 
@@ -292,6 +289,54 @@ static void report_error(FILE *out, void const * const config, void const * cons
 	}
 }
 
-CPUCHECK_CHECKER(cmpxchg, "Performs comparisons and moves using cmpxchg, cmpxchg8b, cmpxchg16b", sizeof(struct config), sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, NULL)
+static struct cpucheck_field const expected[] = {
+	CPUCHECK_FIELD(struct elt, cmpxchg.res_m),
+	CPUCHECK_FIELD(struct elt, cmpxchg.res_rax),
+	CPUCHECK_FIELD(struct elt, cmpxchg.zf),
+	{ NULL, 0, 0 }
+};
+
+static int computes_cmpxchg8b(void const * const config)
+{
+	struct config const * const cfg = config;
+
+	return cfg->cmpxchg8b;
+}
+
+static int computes_cmpxchg16b(void const * const config)
+{
+	struct config const * const cfg = config;
+
+	return cfg->cmpxchg16b;
+}
+
+static char const * kernel(void const * const config)
+{
+	struct config const * const cfg = config;
+
+	if (cfg->cmpxchg8b && cfg->cmpxchg16b)
+		return "cmpxchg, cmpxchg8b and cmpxchg16b";
+	if (cfg->cmpxchg8b)
+		return "cmpxchg and cmpxchg8b";
+	if (cfg->cmpxchg16b)
+		return "cmpxchg and cmpxchg16b";
+	return "cmpxchg";
+}
+
+static struct cpucheck_output const outputs[] = {
+	CPUCHECK_OUTPUT(struct elt, cmpxchg.res_m, struct comp, cmpxchg.m),
+	CPUCHECK_OUTPUT(struct elt, cmpxchg.res_rax, struct comp, cmpxchg.rax),
+	CPUCHECK_OUTPUT(struct elt, cmpxchg.zf, struct comp, cmpxchg.zf),
+	CPUCHECK_OUTPUT_IF(struct elt, cmpxchg8b.zf, struct comp, cmpxchg8b.zf, computes_cmpxchg8b),
+	CPUCHECK_OUTPUT_IF(struct elt, cmpxchg8b.edx, struct comp, cmpxchg8b.edx, computes_cmpxchg8b),
+	CPUCHECK_OUTPUT_IF(struct elt, cmpxchg8b.eax, struct comp, cmpxchg8b.eax, computes_cmpxchg8b),
+	CPUCHECK_OUTPUT_IF(struct elt, cmpxchg8b.res_m, struct comp, cmpxchg8b.m, computes_cmpxchg8b),
+	CPUCHECK_OUTPUT_IF(struct elt, cmpxchg16b.zf, struct comp, cmpxchg16b.zf, computes_cmpxchg16b),
+	CPUCHECK_OUTPUT_IF(struct elt, cmpxchg16b.rdx, struct comp, cmpxchg16b.rdx, computes_cmpxchg16b),
+	CPUCHECK_OUTPUT_IF(struct elt, cmpxchg16b.rax, struct comp, cmpxchg16b.rax, computes_cmpxchg16b),
+	{ NULL, 0, 0, 0, NULL }
+};
+
+CPUCHECK_CHECKER_KERNEL(cmpxchg, "Performs comparisons and moves using cmpxchg, cmpxchg8b, cmpxchg16b", sizeof(struct config), sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, NULL, expected, NULL, outputs, kernel)
 
 #endif	/* ARCH_X86_64 */
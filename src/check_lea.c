@@ -21,7 +21,6 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <inttypes.h>
-#include <time.h>
 #include "cpucheck.h"
 
 struct elt {
@@ -45,8 +44,6 @@ static int init_table(void * const config, void * const table, const size_t tabl
 	size_t i;
 	struct elt * const elts = table;
 
-	srandom(time(NULL));
-
 	for (i=0 ; i<table_size ; i++) {
 		uint8_t *base;
 		base = elts[i].base = (void*) random();
@@ -92,7 +89,23 @@ static void report_error(FILE *out, void const * const config, void const * cons
 	fprintf(out, "mul8, expected=%p, got=%p\n", elt->mul8, c->mul8);
 }
 
-CPUCHECK_CHECKER(lea, "Performs integer additions and multiplications using lea", 0, sizeof(struct elt), sizeof(struct comp), init_table, check_item, report_error, NULL)
+static struct cpucheck_field const expected[] = {
+	CPUCHECK_FIELD(struct elt, nomul),
+	CPUCHECK_FIELD(struct elt, mul2),
+	CPUCHECK_FIELD(struct elt, mul4),
+	CPUCHECK_FIELD(struct elt, mul8),
+	{ NULL, 0, 0 }
+};
+
+static struct cpucheck_output const outputs[] = {
+	CPUCHECK_OUTPUT(struct elt, nomul, struct comp, nomul),
+	CPUCHECK_OUTPUT(struct elt, mul2, struct comp, mul2),
+	CPUCHECK_OUTPUT(struct elt, mul4, struct comp, mul4),
+	CPUCHECK_OUTPUT(struct elt, mul8, struct comp, mul8),
+	{ NULL, 0, 0, 0, NULL }
+};
+
+CPUCHECK_CHECKER_OUTPUTS(lea, "Performs integer additions and multiplications using lea", 0, sizeof(struct elt), sizeof(struct comp), init_table, check_item, report_error, NULL, expected, NULL, outputs)
 
 #endif /* ARCH_X86_64 */
 
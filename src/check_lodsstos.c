@@ -19,7 +19,6 @@
 #if ARCH_X86_64
 
 #include <stdlib.h>
-#include <time.h>
 #include <string.h>
 #include "cpucheck.h"
 
@@ -42,8 +41,6 @@ static int init(void * const config, void * const table, const size_t table_size
 	size_t i, j;
 	struct elt * const elts = table;
 
-	srandom(time(NULL));
-
 	for (i=0 ; i<table_size ; i++) {
 		elts[i].len = random()%MAX_STR_SZ;
 
@@ -102,11 +99,11 @@ static void report_error(FILE *out, void const * const config, void const * cons
 	struct elt const * const elt = table_element;
 	struct comp const * const c = comp;
 
-	hex_dump(out, "src=", elt->src, elt->len);
-	hex_dump(out, "lodsb/stosb result=", c->byte, elt->len);
-	hex_dump(out, "lodsw/stosw result=", c->word, elt->len/2);
-	hex_dump(out, "lodsd/stosd result=", c->dword, elt->len/4);
-	hex_dump(out, "lodsq/stosq result=", c->qword, elt->len/8);
+	cpucheck_hex_dump(out, "src=", elt->src, elt->len);
+	cpucheck_hex_dump(out, "lodsb/stosb result=", c->byte, elt->len);
+	cpucheck_hex_dump(out, "lodsw/stosw result=", c->word, elt->len/2);
+	cpucheck_hex_dump(out, "lodsd/stosd result=", c->dword, elt->len/4);
+	cpucheck_hex_dump(out, "lodsq/stosq result=", c->qword, elt->len/8);
 }
 
 static void delete(void * const config, void * const table, const size_t table_size)
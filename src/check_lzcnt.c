@@ -20,7 +20,6 @@
 
 #include <stdlib.h>
 #include <inttypes.h>
-#include <time.h>
 #include "cpucheck.h"
 
 struct elt {
@@ -71,10 +70,8 @@ static int init(void * const config, void * const table, const size_t table_size
 	if (check_availability())
 		return -1;
 
-	srandom(time(NULL));
-
 	for (i=0 ; i<table_size ; i++) {
-		elts[i].subject = u64random();
+		elts[i].subject = cpucheck_u64random();
 		elts[i].cf = !elts[i].subject;
 		if (!elts[i].subject) {
 			elts[i].res = 64;
@@ -118,7 +115,21 @@ static void report_error(FILE *out, void const * const config, void const * cons
 	fprintf(out, "cf, expected=%s, got=%s\n", elt->cf?"yes":"no", c->cf?"yes":"no");
 }
 
-CPUCHECK_CHECKER(lzcnt, "Count number of leading zeroes using lzcnt", 0, sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, NULL)
+static struct cpucheck_field const expected[] = {
+	CPUCHECK_FIELD(struct elt, res),
+	CPUCHECK_FIELD(struct elt, zf),
+	CPUCHECK_FIELD(struct elt, cf),
+	{ NULL, 0, 0 }
+};
+
+static struct cpucheck_output const outputs[] = {
+	CPUCHECK_OUTPUT(struct elt, res, struct comp, res),
+	CPUCHECK_OUTPUT(struct elt, zf, struct comp, zf),
+	CPUCHECK_OUTPUT(struct elt, cf, struct comp, cf),
+	{ NULL, 0, 0, 0, NULL }
+};
+
+CPUCHECK_CHECKER_OUTPUTS(lzcnt, "Count number of leading zeroes using lzcnt", 0, sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, NULL, expected, NULL, outputs)
 
 #endif	/* ARCH_X86_64 */
 
@@ -0,0 +1,492 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#include <config.h>
+
+#if ARCH_X86_64
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "cpucheck.h"
+
+/* Operands of LIMBS 64 bits limbs, least significant first. Other sizes
+ * include this file with LIMBS, MPA_NAME and MPA_BITS set. */
+#ifndef LIMBS
+#define LIMBS 16
+#define MPA_NAME mpa
+#define MPA_BITS "1024"
+#endif
+#define HALF (LIMBS/2)
+/* The reference uses 32 bits limbs */
+#define LIMBS32 (2*LIMBS)
+
+struct elt {
+	uint64_t a[LIMBS];
+	uint64_t b[LIMBS];
+	/* Odd modulus greater than a and b, and -m^-1 mod 2^64 */
+	uint64_t m[LIMBS];
+	uint64_t minv;
+	uint64_t sum[LIMBS];
+	uint64_t carry;
+	uint64_t diff[LIMBS];
+	uint64_t borrow;
+	uint64_t prod[2*LIMBS];
+	/* a*b*2^-(64*LIMBS) mod m */
+	uint64_t mont[LIMBS];
+};
+
+struct comp {
+	uint64_t sum[LIMBS];
+	uint64_t carry;
+	uint64_t diff[LIMBS];
+	uint64_t borrow;
+	uint64_t prod[2*LIMBS];
+	uint64_t kprod[2*LIMBS];
+	uint64_t mont[LIMBS];
+};
+
+struct config {
+	/* mulx/adcx/adox are available */
+	int adx;
+};
+
+static int has_adx(void)
+{
+	uint32_t max, ebx;
+
+	asm("xorl %%eax, %%eax \n\t"
+		"cpuid \n\t"
+		: "=a" (max)
+		:
+		: "ebx", "ecx", "edx"
+	);
+	if (max < 7)
+		return 0;
+
+	asm("movl $7, %%eax \n\t"
+		"xorl %%ecx, %%ecx \n\t"
+		"cpuid \n\t"
+		: "=b" (ebx)
+		:
+		: "eax", "ecx", "edx"
+	);
+
+	/* BMI2 and ADX */
+	return (ebx & (1<<8|1<<19)) == (1<<8|1<<19);
+}
+
+/* Portable reference, on 32 bits limbs */
+
+static uint32_t ref_add(uint32_t * const r, uint32_t const * const a, uint32_t const * const b, const size_t n)
+{
+	uint64_t t = 0;
+	size_t i;
+
+	for (i=0 ; i<n ; i++) {
+		t = (uint64_t)a[i] + b[i] + (t >> 32);
+		r[i] = t;
+	}
+
+	return t >> 32;
+}
+
+static uint32_t ref_sub(uint32_t * const r, uint32_t const * const a, uint32_t const * const b, const size_t n)
+{
+	uint32_t borrow = 0;
+	uint64_t t;
+	size_t i;
+
+	for (i=0 ; i<n ; i++) {
+		t = (uint64_t)a[i] - b[i] - borrow;
+		r[i] = t;
+		borrow = t >> 63;
+	}
+
+	return borrow;
+}
+
+static void ref_mul(uint32_t * const r, uint32_t const * const a, uint32_t const * const b, const size_t n)
+{
+	uint64_t t;
+	size_t i, j;
+
+	memset(r, 0, 2*n*sizeof(*r));
+	for (i=0 ; i<n ; i++) {
+		for (j=0, t=0 ; j<n ; j++) {
+			t = (uint64_t)a[j]*b[i] + r[i+j] + (t >> 32);
+			r[i+j] = t;
+		}
+		r[i+n] = t >> 32;
+	}
+}
+
+/* Coarsely integrated operand scanning */
+static void ref_mont(uint32_t * const r, uint32_t const * const a, uint32_t const * const b, uint32_t const * const m,
+		const uint32_t minv, const size_t n)
+{
+	uint32_t t[LIMBS32+2], u;
+	uint64_t c;
+	size_t i, j;
+
+	memset(t, 0, sizeof(t));
+	for (i=0 ; i<n ; i++) {
+		for (j=0, c=0 ; j<n ; j++) {
+			c = (uint64_t)a[j]*b[i] + t[j] + (c >> 32);
+			t[j] = c;
+		}
+		c = (uint64_t)t[n] + (c >> 32);
+		t[n] = c;
+		t[n+1] = c >> 32;
+
+		u = t[0]*minv;
+		c = (uint64_t)u*m[0] + t[0];
+		for (j=1 ; j<n ; j++) {
+			c = (uint64_t)u*m[j] + t[j] + (c >> 32);
+			t[j-1] = c;
+		}
+		c = (uint64_t)t[n] + (c >> 32);
+		t[n-1] = c;
+		t[n] = t[n+1] + (c >> 32);
+	}
+
+	for (i=n ; i-- && t[i] == m[i] ; ) ;
+	if (t[n] || i == (size_t)-1 || t[i] > m[i])
+		ref_sub(t, t, m, n);
+	memcpy(r, t, n*sizeof(*r));
+}
+
+static void to32(uint32_t * const r, uint64_t const * const a, const size_t n)
+{
+	size_t i;
+
+	for (i=0 ; i<n ; i++) {
+		r[2*i] = a[i];
+		r[2*i+1] = a[i] >> 32;
+	}
+}
+
+static void to64(uint64_t * const r, uint32_t const * const a, const size_t n)
+{
+	size_t i;
+
+	for (i=0 ; i<n ; i++)
+		r[i] = (uint64_t)a[2*i+1] << 32 | a[2*i];
+}
+
+static int init(void * const config, void * const table, const size_t table_size)
+{
+	struct config * const cfg = config;
+	struct elt * const elts = table;
+	uint32_t a[LIMBS32], b[LIMBS32], m[LIMBS32], r[2*LIMBS32];
+	uint64_t inv;
+	size_t i, j;
+
+	cfg->adx = has_adx();
+
+	for (i=0 ; i<table_size ; i++) {
+		struct elt * const elt = &elts[i];
+
+		for (j=0 ; j<LIMBS ; j++) {
+			elt->a[j] = cpucheck_u64random();
+			elt->b[j] = cpucheck_u64random();
+			elt->m[j] = cpucheck_u64random();
+		}
+		elt->m[0] |= 1;
+		elt->m[LIMBS-1] |= 1ULL<<63;
+		elt->a[LIMBS-1] %= elt->m[LIMBS-1];
+		elt->b[LIMBS-1] %= elt->m[LIMBS-1];
+
+		/* Newton iteration, m*m = 1 mod 8 for odd m */
+		for (j=0, inv=elt->m[0] ; j<5 ; j++)
+			inv *= 2 - elt->m[0]*inv;
+		elt->minv = -inv;
+
+		to32(a, elt->a, LIMBS);
+		to32(b, elt->b, LIMBS);
+		to32(m, elt->m, LIMBS);
+
+		elt->carry = ref_add(r, a, b, LIMBS32);
+		to64(elt->sum, r, LIMBS);
+		elt->borrow = ref_sub(r, a, b, LIMBS32);
+		to64(elt->diff, r, LIMBS);
+		ref_mul(r, a, b, LIMBS32);
+		to64(elt->prod, r, 2*LIMBS);
+		ref_mont(r, a, b, m, elt->minv, LIMBS32);
+		to64(elt->mont, r, LIMBS);
+	}
+
+	return 0;
+}
+
+/* Checked implementations, n must not be null. They store through their
+ * pointers, so they must not be dropped when their result is unused. */
+
+static uint64_t add_n(uint64_t * const r, uint64_t const * const a, uint64_t const * const b, size_t n)
+{
+	uint64_t j = 0, t;
+	uint8_t carry;
+
+	asm volatile("clc \n\t"
+		"1: \n\t"
+		"movq (%[a],%[j],8), %[t] \n\t"
+		"adcq (%[b],%[j],8), %[t] \n\t"
+		"movq %[t], (%[r],%[j],8) \n\t"
+		"leaq 1(%[j]), %[j] \n\t"
+		"decq %[n] \n\t"
+		"jnz 1b \n\t"
+		"setcb %[carry] \n\t"
+		: [j] "+&r" (j), [n] "+&r" (n), [t] "=&r" (t), [carry] "=r" (carry)
+		: [a] "r" (a), [b] "r" (b), [r] "r" (r)
+		: "cc", "memory"
+	);
+
+	return carry;
+}
+
+static uint64_t sub_n(uint64_t * const r, uint64_t const * const a, uint64_t const * const b, size_t n)
+{
+	uint64_t j = 0, t;
+	uint8_t borrow;
+
+	asm volatile("clc \n\t"
+		"1: \n\t"
+		"movq (%[a],%[j],8), %[t] \n\t"
+		"sbbq (%[b],%[j],8), %[t] \n\t"
+		"movq %[t], (%[r],%[j],8) \n\t"
+		"leaq 1(%[j]), %[j] \n\t"
+		"decq %[n] \n\t"
+		"jnz 1b \n\t"
+		"setcb %[borrow] \n\t"
+		: [j] "+&r" (j), [n] "+&r" (n), [t] "=&r" (t), [borrow] "=r" (borrow)
+		: [a] "r" (a), [b] "r" (b), [r] "r" (r)
+		: "cc", "memory"
+	);
+
+	return borrow;
+}
+
+/* r[0..n-1] += a*b, returns the carry limb */
+static uint64_t addmul_1_mulq(uint64_t * const r, uint64_t const * const a, const size_t n, const uint64_t b)
+{
+	uint64_t j = 0, carry = 0;
+
+	asm volatile("1: \n\t"
+		"movq (%[a],%[j],8), %%rax \n\t"
+		"mulq %[b] \n\t"
+		"addq %[carry], %%rax \n\t"
+		"adcq $0, %%rdx \n\t"
+		"addq %%rax, (%[r],%[j],8) \n\t"
+		"adcq $0, %%rdx \n\t"
+		"movq %%rdx, %[carry] \n\t"
+		"incq %[j] \n\t"
+		"cmpq %[n], %[j] \n\t"
+		"jne 1b \n\t"
+		: [j] "+&r" (j), [carry] "+&r" (carry)
+		: [a] "r" (a), [r] "r" (r), [b] "r" (b), [n] "r" (n)
+		: "rax", "rdx", "cc", "memory"
+	);
+
+	return carry;
+}
+
+/* Same with two interleaved carry chains: adcx adds low halves through CF,
+ * adox the previous high half through OF. Loop control must leave both
+ * flags alone, hence lea and jrcxz. */
+static uint64_t addmul_1_adx(uint64_t * const r, uint64_t const * const a, size_t n, const uint64_t b)
+{
+	uint64_t j = 0, carry, lo, hi, t;
+
+	asm volatile("xorl %k[carry], %k[carry] \n\t"
+		"1: \n\t"
+		"mulxq (%[a],%[j],8), %[lo], %[hi] \n\t"
+		"movq (%[r],%[j],8), %[t] \n\t"
+		"adcxq %[lo], %[t] \n\t"
+		"adoxq %[carry], %[t] \n\t"
+		"movq %[t], (%[r],%[j],8) \n\t"
+		"movq %[hi], %[carry] \n\t"
+		"leaq 1(%[j]), %[j] \n\t"
+		"leaq -1(%[n]), %[n] \n\t"
+		"jrcxz 2f \n\t"
+		"jmp 1b \n\t"
+		"2: \n\t"
+		"movl $0, %k[lo] \n\t"
+		"adcxq %[lo], %[carry] \n\t"
+		"adoxq %[lo], %[carry] \n\t"
+		: [j] "+&r" (j), [n] "+&c" (n), [carry] "=&r" (carry), [lo] "=&r" (lo), [hi] "=&r" (hi), [t] "=&r" (t)
+		: [a] "r" (a), [r] "r" (r), "d" (b)
+		: "cc", "memory"
+	);
+
+	return carry;
+}
+
+static uint64_t addmul_1(uint64_t * const r, uint64_t const * const a, const size_t n, const uint64_t b, const int adx)
+{
+	return adx ? addmul_1_adx(r, a, n, b) : addmul_1_mulq(r, a, n, b);
+}
+
+/* r[0..2n-1] = a*b */
+static void schoolbook(uint64_t * const r, uint64_t const * const a, uint64_t const * const b, const size_t n, const int adx)
+{
+	size_t i;
+
+	memset(r, 0, 2*n*sizeof(*r));
+	for (i=0 ; i<n ; i++)
+		r[i+n] = addmul_1(r+i, a, n, b[i], adx);
+}
+
+static void propagate(uint64_t * const r, uint64_t carry, const size_t n)
+{
+	size_t i;
+
+	for (i=0 ; i<n && carry ; i++)
+		carry = !++r[i];
+}
+
+/* One level, on mulq rows: a*b = z2*X^2 + ((a0+a1)(b0+b1)-z0-z2)*X + z0 */
+static void karatsuba(uint64_t * const r, uint64_t const * const a, uint64_t const * const b)
+{
+	uint64_t sa[HALF+1], sb[HALF+1], z1[LIMBS+2], borrow;
+
+	schoolbook(r, a, b, HALF, 0);
+	schoolbook(r+LIMBS, a+HALF, b+HALF, HALF, 0);
+
+	sa[HALF] = add_n(sa, a, a+HALF, HALF);
+	sb[HALF] = add_n(sb, b, b+HALF, HALF);
+	schoolbook(z1, sa, sb, HALF+1, 0);
+
+	borrow = sub_n(z1, z1, r, LIMBS);
+	borrow = sub_n(z1+LIMBS, z1+LIMBS, (uint64_t[2]){ borrow, 0 }, 2);
+	borrow = sub_n(z1, z1, r+LIMBS, LIMBS);
+	sub_n(z1+LIMBS, z1+LIMBS, (uint64_t[2]){ borrow, 0 }, 2);
+
+	propagate(r+HALF+LIMBS+2, add_n(r+HALF, r+HALF, z1, LIMBS+2), LIMBS-HALF-2);
+}
+
+static void mont(uint64_t * const r, uint64_t const * const a, uint64_t const * const b, uint64_t const * const m,
+		const uint64_t minv, const int adx)
+{
+	uint64_t t[LIMBS+2], c;
+	size_t i;
+
+	memset(t, 0, sizeof(t));
+	for (i=0 ; i<LIMBS ; i++) {
+		c = addmul_1(t, a, LIMBS, b[i], adx);
+		t[LIMBS] += c;
+		t[LIMBS+1] = t[LIMBS] < c;
+
+		c = addmul_1(t, m, LIMBS, t[0]*minv, adx);
+		t[LIMBS] += c;
+		t[LIMBS+1] += t[LIMBS] < c;
+
+		memmove(t, t+1, (LIMBS+1)*sizeof(*t));
+		t[LIMBS+1] = 0;
+	}
+
+	for (i=LIMBS ; i-- && t[i] == m[i] ; ) ;
+	if (t[LIMBS] || i == (size_t)-1 || t[i] > m[i])
+		sub_n(t, t, m, LIMBS);
+	memcpy(r, t, LIMBS*sizeof(*r));
+}
+
+static int check_item(void * const comp, void const * const config, void const * const table_element)
+{
+	struct config const * const cfg = config;
+	struct elt const * const elt = table_element;
+	struct comp * const c = comp;
+
+	c->carry = add_n(c->sum, elt->a, elt->b, LIMBS);
+	c->borrow = sub_n(c->diff, elt->a, elt->b, LIMBS);
+	schoolbook(c->prod, elt->a, elt->b, LIMBS, cfg->adx);
+	karatsuba(c->kprod, elt->a, elt->b);
+	mont(c->mont, elt->a, elt->b, elt->m, elt->minv, cfg->adx);
+
+	return ! ( c->carry == elt->carry
+			&& c->borrow == elt->borrow
+			&& !memcmp(c->sum, elt->sum, sizeof(c->sum))
+			&& !memcmp(c->diff, elt->diff, sizeof(c->diff))
+			&& !memcmp(c->prod, elt->prod, sizeof(c->prod))
+			&& !memcmp(c->kprod, elt->prod, sizeof(c->kprod))
+			&& !memcmp(c->mont, elt->mont, sizeof(c->mont))
+	);
+}
+
+static void report_part(FILE *out, char const * const what, void const * const expected, void const * const got, const size_t len)
+{
+	char title[64];
+
+	if (!memcmp(expected, got, len))
+		return;
+
+	snprintf(title, sizeof(title), "%s, expected=", what);
+	cpucheck_hex_dump(out, title, expected, len);
+	cpucheck_hex_dump(out, "got=", got, len);
+}
+
+static char const * kernel(void const * const config)
+{
+	struct config const * const cfg = config;
+
+	return cfg->adx ? "mulx/adcx/adox" : "mulq/adc";
+}
+
+static void report_error(FILE *out, void const * const config, void const * const table_element, void const * const comp)
+{
+	struct elt const * const elt = table_element;
+	struct comp const * const c = comp;
+
+	fprintf(out, "Products rows use %s\n", kernel(config));
+	cpucheck_hex_dump(out, "a=", (char const *)elt->a, sizeof(elt->a));
+	cpucheck_hex_dump(out, "b=", (char const *)elt->b, sizeof(elt->b));
+	cpucheck_hex_dump(out, "m=", (char const *)elt->m, sizeof(elt->m));
+	report_part(out, "Sum", elt->sum, c->sum, sizeof(c->sum));
+	report_part(out, "Sum carry", &elt->carry, &c->carry, sizeof(c->carry));
+	report_part(out, "Difference", elt->diff, c->diff, sizeof(c->diff));
+	report_part(out, "Difference borrow", &elt->borrow, &c->borrow, sizeof(c->borrow));
+	report_part(out, "Schoolbook product", elt->prod, c->prod, sizeof(c->prod));
+	report_part(out, "Karatsuba product", elt->prod, c->kprod, sizeof(c->kprod));
+	report_part(out, "Montgomery product", elt->mont, c->mont, sizeof(c->mont));
+}
+
+static struct cpucheck_field const expected[] = {
+	CPUCHECK_FIELD(struct elt, sum),
+	CPUCHECK_FIELD(struct elt, carry),
+	CPUCHECK_FIELD(struct elt, diff),
+	CPUCHECK_FIELD(struct elt, borrow),
+	CPUCHECK_FIELD(struct elt, prod),
+	CPUCHECK_FIELD(struct elt, mont),
+	{ NULL, 0, 0 }
+};
+
+static struct cpucheck_output const outputs[] = {
+	CPUCHECK_OUTPUT(struct elt, sum, struct comp, sum),
+	CPUCHECK_OUTPUT(struct elt, carry, struct comp, carry),
+	CPUCHECK_OUTPUT(struct elt, diff, struct comp, diff),
+	CPUCHECK_OUTPUT(struct elt, borrow, struct comp, borrow),
+	CPUCHECK_OUTPUT(struct elt, prod, struct comp, prod),
+	CPUCHECK_OUTPUT(struct elt, prod, struct comp, kprod),
+	CPUCHECK_OUTPUT(struct elt, mont, struct comp, mont),
+	{ NULL, 0, 0, 0, NULL }
+};
+
+/* Expands MPA_NAME before it gets pasted */
+#define MPA_CHECKER(name, description) \
+	CPUCHECK_CHECKER_KERNEL(name, description, sizeof(struct config), sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, NULL, expected, NULL, outputs, kernel)
+
+MPA_CHECKER(MPA_NAME, "Performs " MPA_BITS " bits additions, subtractions, schoolbook, Karatsuba and Montgomery multiplications (adc/sbb/mulx/adcx/adox)")
+
+#endif /* ARCH_X86_64 */
@@ -16,7 +16,6 @@
 
 #include <config.h>
 #include <stdlib.h>
-#include <time.h>
 #include "cpucheck.h"
 
 struct elt {
@@ -35,12 +34,10 @@ static int init(void * const config, void * const table, const size_t table_size
 	size_t i;
 	struct elt * const elts = table;
 
-	srandom(time(NULL));
-
 	for (i=0 ; i<table_size ; i++) {
 		unsigned long int a, b;
-		a = ulirandom();
-		b = ulirandom();
+		a = cpucheck_ulirandom();
+		b = cpucheck_ulirandom();
 		elts[i].a = a < b ? b : a;
 		elts[i].b = a < b ? a : b;
 		elts[i].c = random();
@@ -69,5 +66,15 @@ static void report_error(FILE *out, void const * const config, void const * cons
 			elt->c, elt->res, c->res);
 }
 
-CPUCHECK_CHECKER(muldiv, "Performs integer multiplications and divisions", 0, sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, NULL)
+static struct cpucheck_field const expected[] = {
+	CPUCHECK_FIELD(struct elt, res),
+	{ NULL, 0, 0 }
+};
+
+static struct cpucheck_output const outputs[] = {
+	CPUCHECK_OUTPUT(struct elt, res, struct comp, res),
+	{ NULL, 0, 0, 0, NULL }
+};
+
+CPUCHECK_CHECKER_OUTPUTS(muldiv, "Performs integer multiplications and divisions", 0, sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, NULL, expected, NULL, outputs)
 
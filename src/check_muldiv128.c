@@ -0,0 +1,344 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#include <config.h>
+
+#if ARCH_X86_64
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include "cpucheck.h"
+
+/* Independent divisions per element, so that the divider never idles */
+#define DIVS 4
+/* Sign-extended 32 bits immediate of the three operands imul */
+#define IMUL_IMM -0x3b9aca07
+
+/* Reference values, __extension__ keeps -pedantic quiet */
+__extension__ typedef unsigned __int128 u128;
+__extension__ typedef __int128 s128;
+
+struct elt {
+	uint64_t a;
+	uint64_t b;
+	uint64_t mul_lo;
+	uint64_t mul_hi;
+	uint64_t imul_lo;
+	uint64_t imul_hi;
+	uint64_t imul3;
+	/* divq operands and results */
+	uint64_t un_hi[DIVS];
+	uint64_t un_lo[DIVS];
+	uint64_t ud[DIVS];
+	uint64_t uq[DIVS];
+	uint64_t ur[DIVS];
+	/* idivq operands and results */
+	uint64_t sn_hi[DIVS];
+	uint64_t sn_lo[DIVS];
+	uint64_t sd[DIVS];
+	uint64_t sq[DIVS];
+	uint64_t sr[DIVS];
+};
+
+struct comp {
+	uint64_t mul_lo;
+	uint64_t mul_hi;
+	uint64_t imul_lo;
+	uint64_t imul_hi;
+	uint64_t imul2;
+	uint64_t imul3;
+	uint64_t mulx_lo;
+	uint64_t mulx_hi;
+	uint64_t uq[DIVS];
+	uint64_t ur[DIVS];
+	uint64_t sq[DIVS];
+	uint64_t sr[DIVS];
+};
+
+struct config {
+	/* mulx is available */
+	int bmi2;
+};
+
+static int has_bmi2(void)
+{
+	uint32_t max, ebx;
+
+	asm("xorl %%eax, %%eax \n\t"
+		"cpuid \n\t"
+		: "=a" (max)
+		:
+		: "ebx", "ecx", "edx"
+	);
+	if (max < 7)
+		return 0;
+
+	asm("movl $7, %%eax \n\t"
+		"xorl %%ecx, %%ecx \n\t"
+		"cpuid \n\t"
+		: "=b" (ebx)
+		:
+		: "eax", "ecx", "edx"
+	);
+
+	return !!(ebx & 1<<8);
+}
+
+static uint64_t operand(void)
+{
+	static const uint64_t edges[] = { 0, 1, UINT64_MAX, INT64_MAX, (uint64_t)INT64_MIN, UINT32_MAX, 1ULL<<32 };
+
+	if (random()%8)
+		return cpucheck_u64random() >> (random()%64);
+	return edges[random() % (sizeof(edges)/sizeof(*edges))];
+}
+
+static uint64_t divisor(void)
+{
+	uint64_t d;
+
+	do {
+		d = cpucheck_u64random() >> (random()%64);
+	} while (!d);
+
+	return d;
+}
+
+/* The quotient of a 128 by 64 bits division must fit in 64 bits, one
+ * element in four gets the largest quotient possible */
+static void init_udiv(struct elt * const elt, const unsigned int i)
+{
+	u128 n;
+
+	elt->ud[i] = divisor();
+	if (random()%4) {
+		elt->un_hi[i] = cpucheck_u64random() % elt->ud[i];
+		elt->un_lo[i] = cpucheck_u64random();
+	} else {
+		elt->un_hi[i] = elt->ud[i] - 1;
+		elt->un_lo[i] = UINT64_MAX;
+	}
+
+	n = (u128)elt->un_hi[i] << 64 | elt->un_lo[i];
+	elt->uq[i] = n / elt->ud[i];
+	elt->ur[i] = n % elt->ud[i];
+}
+
+static void init_sdiv(struct elt * const elt, const unsigned int i)
+{
+	s128 n, q;
+	int64_t d;
+
+	if (random()%16) {
+		d = divisor() >> 1;
+		if (!d || random()%2)
+			d = -d - 1;
+	} else
+		d = random()%2 ? -1 : INT64_MIN;
+
+	if (random()%4) {
+		do {
+			n = (s128)((u128)((int64_t)cpucheck_u64random() >> (random()%64)) << 64 | cpucheck_u64random());
+			q = n / d;
+		} while (q > INT64_MAX || q < INT64_MIN);
+	} else {
+		/* Quotient at either end of its range, remainder as large as allowed */
+		q = random()%2 ? INT64_MAX : INT64_MIN;
+		n = q * d;
+		if (d != 1 && d != -1)
+			n += ((q < 0) == (d < 0) ? 1 : -1) * (s128)(cpucheck_u64random() % (d < 0 ? -(uint64_t)d : (uint64_t)d));
+	}
+
+	elt->sn_hi[i] = (uint64_t)(n >> 64);
+	elt->sn_lo[i] = (uint64_t)n;
+	elt->sd[i] = d;
+	elt->sq[i] = (int64_t)(n / d);
+	elt->sr[i] = (int64_t)(n % d);
+}
+
+static int init(void * const config, void * const table, const size_t table_size)
+{
+	struct config * const cfg = config;
+	struct elt * const elts = table;
+	u128 up;
+	s128 sp;
+	size_t i;
+	unsigned int j;
+
+	cfg->bmi2 = has_bmi2();
+
+	for (i=0 ; i<table_size ; i++) {
+		struct elt * const elt = &elts[i];
+
+		elt->a = operand();
+		elt->b = operand();
+
+		up = (u128)elt->a * elt->b;
+		elt->mul_lo = up;
+		elt->mul_hi = up >> 64;
+
+		sp = (s128)(int64_t)elt->a * (int64_t)elt->b;
+		elt->imul_lo = sp;
+		elt->imul_hi = (u128)sp >> 64;
+
+		elt->imul3 = elt->a * (uint64_t)(int64_t)IMUL_IMM;
+
+		for (j=0 ; j<DIVS ; j++) {
+			init_udiv(elt, j);
+			init_sdiv(elt, j);
+		}
+	}
+
+	return 0;
+}
+
+static int check_item(void * const comp, void const * const config, void const * const table_element)
+{
+	struct config const * const cfg = config;
+	struct elt const * const elt = table_element;
+	struct comp * const c = comp;
+	unsigned int i;
+	int r;
+
+	asm("mulq %[b] \n\t"
+		: "=a" (c->mul_lo), "=d" (c->mul_hi)
+		: "a" (elt->a), [b] "rm" (elt->b)
+		: "cc"
+	);
+
+	asm("imulq %[b] \n\t"
+		: "=a" (c->imul_lo), "=d" (c->imul_hi)
+		: "a" (elt->a), [b] "rm" (elt->b)
+		: "cc"
+	);
+
+	asm("imulq %[b], %[r] \n\t"
+		: [r] "=r" (c->imul2)
+		: "0" (elt->a), [b] "rm" (elt->b)
+		: "cc"
+	);
+
+	asm("imulq %[imm], %[a], %[r] \n\t"
+		: [r] "=r" (c->imul3)
+		: [a] "rm" (elt->a), [imm] "i" (IMUL_IMM)
+		: "cc"
+	);
+
+	if (cfg->bmi2)
+		asm("mulxq %[b], %[lo], %[hi] \n\t"
+			: [lo] "=r" (c->mulx_lo), [hi] "=r" (c->mulx_hi)
+			: "d" (elt->a), [b] "rm" (elt->b)
+		);
+
+	for (i=0 ; i<DIVS ; i++)
+		asm("divq %[d] \n\t"
+			: "=a" (c->uq[i]), "=d" (c->ur[i])
+			: "a" (elt->un_lo[i]), "d" (elt->un_hi[i]), [d] "rm" (elt->ud[i])
+			: "cc"
+		);
+
+	for (i=0 ; i<DIVS ; i++)
+		asm("idivq %[d] \n\t"
+			: "=a" (c->sq[i]), "=d" (c->sr[i])
+			: "a" (elt->sn_lo[i]), "d" (elt->sn_hi[i]), [d] "rm" (elt->sd[i])
+			: "cc"
+		);
+
+	r = c->mul_lo == elt->mul_lo && c->mul_hi == elt->mul_hi
+		&& c->imul_lo == elt->imul_lo && c->imul_hi == elt->imul_hi
+		&& c->imul2 == elt->mul_lo && c->imul3 == elt->imul3
+		&& (!cfg->bmi2 || (c->mulx_lo == elt->mul_lo && c->mulx_hi == elt->mul_hi));
+	for (i=0 ; i<DIVS ; i++)
+		r = r && c->uq[i] == elt->uq[i] && c->ur[i] == elt->ur[i]
+			&& c->sq[i] == elt->sq[i] && c->sr[i] == elt->sr[i];
+
+	return !r;
+}
+
+static void report_error(FILE *out, void const * const config, void const * const table_element, void const * const comp)
+{
+	struct config const * const cfg = config;
+	struct elt const * const elt = table_element;
+	struct comp const * const c = comp;
+	unsigned int i;
+
+	fprintf(out, "a=%#"PRIx64", b=%#"PRIx64"\n", elt->a, elt->b);
+	fprintf(out, "mulq: expected=%#"PRIx64":%016"PRIx64", got=%#"PRIx64":%016"PRIx64"\n",
+			elt->mul_hi, elt->mul_lo, c->mul_hi, c->mul_lo);
+	if (cfg->bmi2)
+		fprintf(out, "mulx: expected=%#"PRIx64":%016"PRIx64", got=%#"PRIx64":%016"PRIx64"\n",
+				elt->mul_hi, elt->mul_lo, c->mulx_hi, c->mulx_lo);
+	fprintf(out, "imulq: expected=%#"PRIx64":%016"PRIx64", got=%#"PRIx64":%016"PRIx64"\n",
+			elt->imul_hi, elt->imul_lo, c->imul_hi, c->imul_lo);
+	fprintf(out, "imulq a, b: expected=%#"PRIx64", got=%#"PRIx64"\n", elt->mul_lo, c->imul2);
+	fprintf(out, "imulq $%d, a: expected=%#"PRIx64", got=%#"PRIx64"\n", IMUL_IMM, elt->imul3, c->imul3);
+
+	for (i=0 ; i<DIVS ; i++) {
+		if (c->uq[i] != elt->uq[i] || c->ur[i] != elt->ur[i])
+			fprintf(out, "divq %#"PRIx64":%016"PRIx64" / %#"PRIx64": expected q=%#"PRIx64" r=%#"PRIx64", got q=%#"PRIx64" r=%#"PRIx64"\n",
+					elt->un_hi[i], elt->un_lo[i], elt->ud[i], elt->uq[i], elt->ur[i], c->uq[i], c->ur[i]);
+		if (c->sq[i] != elt->sq[i] || c->sr[i] != elt->sr[i])
+			fprintf(out, "idivq %#"PRIx64":%016"PRIx64" / %"PRId64": expected q=%"PRId64" r=%"PRId64", got q=%"PRId64" r=%"PRId64"\n",
+					elt->sn_hi[i], elt->sn_lo[i], (int64_t)elt->sd[i], (int64_t)elt->sq[i], (int64_t)elt->sr[i],
+					(int64_t)c->sq[i], (int64_t)c->sr[i]);
+	}
+}
+
+static struct cpucheck_field const expected[] = {
+	CPUCHECK_FIELD(struct elt, mul_lo),
+	CPUCHECK_FIELD(struct elt, mul_hi),
+	CPUCHECK_FIELD(struct elt, imul_lo),
+	CPUCHECK_FIELD(struct elt, imul_hi),
+	CPUCHECK_FIELD(struct elt, imul3),
+	CPUCHECK_FIELD(struct elt, uq),
+	CPUCHECK_FIELD(struct elt, ur),
+	CPUCHECK_FIELD(struct elt, sq),
+	CPUCHECK_FIELD(struct elt, sr),
+	{ NULL, 0, 0 }
+};
+
+static int computes_mulx(void const * const config)
+{
+	struct config const * const cfg = config;
+
+	return cfg->bmi2;
+}
+
+static char const * kernel(void const * const config)
+{
+	return computes_mulx(config) ? "mulq and mulx" : "mulq";
+}
+
+static struct cpucheck_output const outputs[] = {
+	CPUCHECK_OUTPUT(struct elt, mul_lo, struct comp, mul_lo),
+	CPUCHECK_OUTPUT(struct elt, mul_hi, struct comp, mul_hi),
+	CPUCHECK_OUTPUT(struct elt, imul_lo, struct comp, imul_lo),
+	CPUCHECK_OUTPUT(struct elt, imul_hi, struct comp, imul_hi),
+	CPUCHECK_OUTPUT(struct elt, mul_lo, struct comp, imul2),
+	CPUCHECK_OUTPUT(struct elt, imul3, struct comp, imul3),
+	CPUCHECK_OUTPUT_IF(struct elt, mul_lo, struct comp, mulx_lo, computes_mulx),
+	CPUCHECK_OUTPUT_IF(struct elt, mul_hi, struct comp, mulx_hi, computes_mulx),
+	CPUCHECK_OUTPUT(struct elt, uq, struct comp, uq),
+	CPUCHECK_OUTPUT(struct elt, ur, struct comp, ur),
+	CPUCHECK_OUTPUT(struct elt, sq, struct comp, sq),
+	CPUCHECK_OUTPUT(struct elt, sr, struct comp, sr),
+	{ NULL, 0, 0, 0, NULL }
+};
+
+CPUCHECK_CHECKER_KERNEL(muldiv128, "Performs full width mulq, imulq, mulx, and 128 by 64 bits divq and idivq", sizeof(struct config), sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, NULL, expected, NULL, outputs, kernel)
+
+#endif /* ARCH_X86_64 */
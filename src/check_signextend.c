@@ -19,7 +19,6 @@
 #if ARCH_X86_64
 
 #include <stdlib.h>
-#include <time.h>
 #include <stdint.h>
 #include <inttypes.h>
 #include "cpucheck.h"
@@ -52,37 +51,36 @@ struct comp {
 	int64_t qword_exl;
 };
 
+static void fill(struct elt * const elt, const int8_t byte, const int16_t word, const int32_t dword, const int64_t qword)
+{
+	elt->byte = byte;
+	elt->byte_ex = elt->byte;
+	elt->word = word;
+	elt->word_ex = elt->word;
+	elt->word_exl = elt->word;
+	elt->word_exh = elt->word < 0 ? -1 : 0;
+	elt->dword = dword;
+	elt->dword_ex = elt->dword;
+	elt->dword_exl = elt->dword;
+	elt->dword_exh = elt->dword < 0 ? -1 : 0;
+	elt->qword = qword;
+	elt->qword_exl = elt->qword;
+	elt->qword_exh = elt->qword < 0 ? -1 : 0;
+}
+
 static int init(void * const config, void * const table, const size_t table_size)
 {
 	size_t i;
 	struct elt * const elts = table;
 
-	srandom(time(NULL));
-
-	for (i=0 ; i<table_size ; i++) {
-		elts[i].byte = u64random();
-		elts[i].byte_ex = elts[i].byte;
-		elts[i].word = u64random();
-		elts[i].word_ex = elts[i].word;
-		elts[i].word_exl = elts[i].word;
-		elts[i].word_exh = elts[i].word < 0 ? -1 : 0;
-		elts[i].dword = u64random();
-		elts[i].dword_ex = elts[i].dword;
-		elts[i].dword_exl = elts[i].dword;
-		elts[i].dword_exh = elts[i].dword < 0 ? -1 : 0;
-		elts[i].qword = u64random();
-		elts[i].qword_exl = elts[i].qword;
-		elts[i].qword_exh = elts[i].qword < 0 ? -1 : 0;
-	}
+	for (i=0 ; i<table_size ; i++)
+		fill(&elts[i], cpucheck_u64random(), cpucheck_u64random(), cpucheck_u64random(), cpucheck_u64random());
 
 	return 0;
 }
 
-static int check_item(void * const comp, void const * const config, void const * const table_element)
+static inline void extend(struct comp * const c, const int8_t byte, const int16_t word, const int32_t dword, const int64_t qword)
 {
-	struct elt const * const elt = table_element;
-	struct comp * const c = comp;
-
 	asm("movb %[byte], %%al \n\t"
 		"cbw \n\t"
 		"movw %%ax, %[byte_ex] \n\t"
@@ -107,10 +105,18 @@ static int check_item(void * const comp, void const * const config, void const *
 		  [dword_ex] "=&rm" (c->dword_ex), [dword_exl] "=&rm" (c->dword_exl),
 		  [dword_exh] "=&rm" (c->dword_exh), [qword_exl] "=&rm" (c->qword_exl),
 		  [qword_exh] "=&rm" (c->qword_exh)
-		: [byte] "rm" (elt->byte), [word] "rm" (elt->word),
-		  [dword] "rm" (elt->dword), [qword] "rm" (elt->qword)
+		: [byte] "rm" (byte), [word] "rm" (word),
+		  [dword] "rm" (dword), [qword] "rm" (qword)
 		: "rax", "rdx"
 	);
+}
+
+static int check_item(void * const comp, void const * const config, void const * const table_element)
+{
+	struct elt const * const elt = table_element;
+	struct comp * const c = comp;
+
+	extend(c, elt->byte, elt->word, elt->dword, elt->qword);
 
 	return !( c->byte_ex == elt->byte_ex
 				&& c->word_ex == elt->word_ex
@@ -150,6 +156,113 @@ static void report_error(FILE *out, void const * const config, void const * cons
 			elt->qword_exh, c->qword_exh);
 }
 
-CPUCHECK_CHECKER(signextend, "Performs sign extension (cbw, cwde, cdqe, cwd, cdq, cqo)", 0, sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, NULL)
+static struct cpucheck_field const expected[] = {
+	CPUCHECK_FIELD(struct elt, byte_ex),
+	CPUCHECK_FIELD(struct elt, word_ex),
+	CPUCHECK_FIELD(struct elt, word_exh),
+	CPUCHECK_FIELD(struct elt, word_exl),
+	CPUCHECK_FIELD(struct elt, dword_ex),
+	CPUCHECK_FIELD(struct elt, dword_exh),
+	CPUCHECK_FIELD(struct elt, dword_exl),
+	CPUCHECK_FIELD(struct elt, qword_exh),
+	CPUCHECK_FIELD(struct elt, qword_exl),
+	{ NULL, 0, 0 }
+};
+
+/* Compact layout, expected results are folded in digest */
+struct compact_elt {
+	int64_t qword;
+	int32_t dword;
+	int16_t word;
+	int8_t byte;
+	uint64_t digest;
+};
+
+static uint64_t digest(struct comp const * const c)
+{
+	uint64_t h = 0;
+
+	h = cpucheck_digest(h, c->byte_ex);
+	h = cpucheck_digest(h, c->word_ex);
+	h = cpucheck_digest(h, c->word_exh);
+	h = cpucheck_digest(h, c->word_exl);
+	h = cpucheck_digest(h, c->dword_ex);
+	h = cpucheck_digest(h, c->dword_exh);
+	h = cpucheck_digest(h, c->dword_exl);
+	h = cpucheck_digest(h, c->qword_exh);
+	h = cpucheck_digest(h, c->qword_exl);
+
+	return h;
+}
+
+static int init_compact(void * const config, void * const table, const size_t table_size)
+{
+	struct compact_elt * const celts = table;
+	struct elt elt;
+	struct comp expected;
+	size_t i;
+
+	for (i=0 ; i<table_size ; i++) {
+		fill(&elt, cpucheck_u64random(), cpucheck_u64random(), cpucheck_u64random(), cpucheck_u64random());
+		celts[i].byte = elt.byte;
+		celts[i].word = elt.word;
+		celts[i].dword = elt.dword;
+		celts[i].qword = elt.qword;
+
+		expected.byte_ex = elt.byte_ex;
+		expected.word_ex = elt.word_ex;
+		expected.word_exh = elt.word_exh;
+		expected.word_exl = elt.word_exl;
+		expected.dword_ex = elt.dword_ex;
+		expected.dword_exh = elt.dword_exh;
+		expected.dword_exl = elt.dword_exl;
+		expected.qword_exh = elt.qword_exh;
+		expected.qword_exl = elt.qword_exl;
+		celts[i].digest = digest(&expected);
+	}
+
+	return 0;
+}
+
+static int check_compact(void * const comp, void const * const config, void const * const table_element)
+{
+	struct compact_elt const * const celt = table_element;
+	struct comp * const c = comp;
+
+	extend(c, celt->byte, celt->word, celt->dword, celt->qword);
+
+	return digest(c) != celt->digest;
+}
+
+static void report_compact(FILE *out, void const * const config, void const * const table_element, void const * const comp)
+{
+	struct compact_elt const * const celt = table_element;
+	struct elt elt;
+
+	fprintf(out, "digest, expected=0x%" PRIx64 ", got=0x%" PRIx64 "\n", celt->digest, digest(comp));
+	fill(&elt, celt->byte, celt->word, celt->dword, celt->qword);
+	report_error(out, config, &elt, comp);
+}
+
+static struct cpucheck_field const compact_expected[] = {
+	CPUCHECK_FIELD(struct compact_elt, digest),
+	{ NULL, 0, 0 }
+};
+
+static struct cpucheck_output const outputs[] = {
+	CPUCHECK_OUTPUT(struct elt, byte_ex, struct comp, byte_ex),
+	CPUCHECK_OUTPUT(struct elt, word_ex, struct comp, word_ex),
+	CPUCHECK_OUTPUT(struct elt, word_exh, struct comp, word_exh),
+	CPUCHECK_OUTPUT(struct elt, word_exl, struct comp, word_exl),
+	CPUCHECK_OUTPUT(struct elt, dword_ex, struct comp, dword_ex),
+	CPUCHECK_OUTPUT(struct elt, dword_exh, struct comp, dword_exh),
+	CPUCHECK_OUTPUT(struct elt, dword_exl, struct comp, dword_exl),
+	CPUCHECK_OUTPUT(struct elt, qword_exh, struct comp, qword_exh),
+	CPUCHECK_OUTPUT(struct elt, qword_exl, struct comp, qword_exl),
+	{ NULL, 0, 0, 0, NULL }
+};
+
+CPUCHECK_CHECKER_EXPECTED(signextend_compact, "Performs sign extension (cbw, cwde, cdqe, cwd, cdq, cqo), compact table", 0, sizeof(struct compact_elt), sizeof(struct comp), init_compact, check_compact, report_compact, NULL, compact_expected)
+CPUCHECK_CHECKER_OUTPUTS(signextend, "Performs sign extension (cbw, cwde, cdqe, cwd, cdq, cqo)", 0, sizeof(struct elt), sizeof(struct comp), init, check_item, report_error, NULL, expected, &cpucheck_checker_signextend_compact, outputs)
 
 #endif /* ARCH_X86_64 */
@@ -0,0 +1,309 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "chunks.h"
+
+#define min(a, b) ((a)<(b)?(a):(b))
+
+/* Chunks [head;tail[ are left, the owner takes from head, thieves from tail */
+struct chunk_queue {
+	pthread_mutex_t lock;
+	size_t head;
+	size_t tail;
+} __attribute__((aligned(64)));
+
+struct chunk_sched {
+	size_t table_size;
+	size_t chunk_size;
+	size_t nb_chunks;
+	unsigned int nb_queues;
+	unsigned int nb_slots;
+	unsigned int target;
+	pthread_mutex_t refill;
+	unsigned long int pass;
+	struct chunk_queue *queues;
+	/* Protected by refill */
+	double *weights;
+	/* nb_chunks counters per slot */
+	uint8_t *coverage;
+	/* Chunks below target per slot */
+	size_t *remaining;
+	unsigned int covered;
+};
+
+struct chunk_sched * chunk_sched_new(const size_t table_size, const size_t chunk_size,
+		const unsigned int nb_queues, const unsigned int nb_slots, const unsigned int target)
+{
+	struct chunk_sched *sched;
+	unsigned int i;
+
+	if (!table_size || !chunk_size || !nb_queues || !nb_slots || target > CHUNKS_MAX_COVERAGE) {
+		fprintf(stderr, "Invalid chunk scheduler parameters\n");
+		return NULL;
+	}
+
+	sched = malloc(sizeof(*sched));
+	if (!sched) {
+		fprintf(stderr, "Could not allocate chunk scheduler\n");
+		return NULL;
+	}
+	sched->table_size = table_size;
+	sched->chunk_size = chunk_size;
+	sched->nb_chunks = table_size/chunk_size + !!(table_size%chunk_size);
+	sched->nb_queues = nb_queues;
+	sched->nb_slots = nb_slots;
+	sched->target = target;
+	sched->pass = 0;
+	sched->covered = 0;
+
+	if (SIZE_MAX/nb_slots < sched->nb_chunks) {
+		fprintf(stderr, "Too many chunks to track coverage\n");
+		goto err_sched;
+	}
+
+	if (pthread_mutex_init(&sched->refill, NULL)) {
+		fprintf(stderr, "Could not allocate chunk scheduler mutex\n");
+		goto err_sched;
+	}
+
+	if (posix_memalign((void**)&sched->queues, 64, sizeof(*sched->queues)*nb_queues)) {
+		fprintf(stderr, "Could not allocate chunk queues\n");
+		goto err_refill;
+	}
+	for (i=0 ; i<nb_queues ; i++) {
+		if (pthread_mutex_init(&sched->queues[i].lock, NULL)) {
+			fprintf(stderr, "Could not allocate chunk queue mutex\n");
+			while (i--)
+				pthread_mutex_destroy(&sched->queues[i].lock);
+			goto err_queues;
+		}
+		sched->queues[i].head = sched->queues[i].tail = 0;
+	}
+
+	sched->weights = malloc(sizeof(*sched->weights)*nb_queues);
+	if (!sched->weights) {
+		fprintf(stderr, "Could not allocate chunk queue weights\n");
+		goto err_locks;
+	}
+	for (i=0 ; i<nb_queues ; i++)
+		sched->weights[i] = 1;
+
+	sched->coverage = calloc(sched->nb_chunks*nb_slots, sizeof(*sched->coverage));
+	if (!sched->coverage) {
+		fprintf(stderr, "Could not allocate coverage counters\n");
+		goto err_weights;
+	}
+
+	sched->remaining = malloc(sizeof(*sched->remaining)*nb_slots);
+	if (!sched->remaining) {
+		fprintf(stderr, "Could not allocate coverage counters\n");
+		goto err_coverage;
+	}
+	for (i=0 ; i<nb_slots ; i++)
+		sched->remaining[i] = sched->nb_chunks;
+
+	return sched;
+
+err_coverage:
+	free(sched->coverage);
+err_weights:
+	free(sched->weights);
+err_locks:
+	for (i=0 ; i<nb_queues ; i++)
+		pthread_mutex_destroy(&sched->queues[i].lock);
+err_queues:
+	free(sched->queues);
+err_refill:
+	pthread_mutex_destroy(&sched->refill);
+err_sched:
+	free(sched);
+	return NULL;
+}
+
+void chunk_sched_delete(struct chunk_sched * const sched)
+{
+	unsigned int i;
+
+	free(sched->remaining);
+	free(sched->coverage);
+	free(sched->weights);
+	for (i=0 ; i<sched->nb_queues ; i++)
+		pthread_mutex_destroy(&sched->queues[i].lock);
+	free(sched->queues);
+	pthread_mutex_destroy(&sched->refill);
+	free(sched);
+}
+
+static int take(struct chunk_queue * const q, const int steal, size_t * const chunk)
+{
+	int r = -1;
+
+	pthread_mutex_lock(&q->lock);
+	if (q->head < q->tail) {
+		*chunk = steal ? --q->tail : q->head++;
+		r = 0;
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	return r;
+}
+
+/* Starts a new pass once every queue is empty */
+static void refill(struct chunk_sched * const sched)
+{
+	double total = 0, cumulated = 0;
+	unsigned int i, q;
+	size_t head;
+
+	pthread_mutex_lock(&sched->refill);
+
+	for (i=0 ; i<sched->nb_queues ; i++) {
+		pthread_mutex_lock(&sched->queues[i].lock);
+		q = sched->queues[i].head < sched->queues[i].tail;
+		pthread_mutex_unlock(&sched->queues[i].lock);
+		if (q)
+			break;
+	}
+
+	if (i == sched->nb_queues) {
+		__atomic_store_n(&sched->pass, sched->pass+1, __ATOMIC_RELAXED);
+		for (i=0 ; i<sched->nb_queues ; i++)
+			total += sched->weights[i];
+		for (i=0, head=0 ; i<sched->nb_queues ; i++) {
+			q = (i + sched->pass) % sched->nb_queues;
+			cumulated += sched->weights[q];
+			pthread_mutex_lock(&sched->queues[q].lock);
+			sched->queues[q].head = head;
+			sched->queues[q].tail = head = i == sched->nb_queues-1 ? sched->nb_chunks
+				: min(sched->nb_chunks * (cumulated / total), sched->nb_chunks);
+			pthread_mutex_unlock(&sched->queues[q].lock);
+		}
+	}
+
+	pthread_mutex_unlock(&sched->refill);
+}
+
+size_t chunk_sched_next(struct chunk_sched * const sched, const unsigned int queue, size_t * const start, size_t * const count)
+{
+	const unsigned int own = queue % sched->nb_queues;
+	unsigned int i;
+	size_t chunk;
+
+	for (;;) {
+		if (!take(&sched->queues[own], 0, &chunk))
+			break;
+		for (i=1 ; i<sched->nb_queues ; i++)
+			if (!take(&sched->queues[(own+i)%sched->nb_queues], 1, &chunk))
+				break;
+		if (i < sched->nb_queues)
+			break;
+		refill(sched);
+	}
+
+	*start = chunk * sched->chunk_size;
+	*count = chunk == sched->nb_chunks-1 ? sched->table_size - *start : sched->chunk_size;
+
+	return chunk;
+}
+
+void chunk_sched_done(struct chunk_sched * const sched, const size_t chunk, const int slot)
+{
+	uint8_t *counter, cur;
+
+	if (slot < 0 || (unsigned int)slot >= sched->nb_slots)
+		return;
+
+	counter = &sched->coverage[(size_t)slot*sched->nb_chunks + chunk];
+	cur = __atomic_load_n(counter, __ATOMIC_RELAXED);
+	do {
+		if (cur == CHUNKS_MAX_COVERAGE)
+			return;
+	} while (!__atomic_compare_exchange_n(counter, &cur, cur+1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	if (sched->target && cur+1 == sched->target
+			&& __atomic_sub_fetch(&sched->remaining[slot], 1, __ATOMIC_RELAXED) == 0)
+		__atomic_add_fetch(&sched->covered, 1, __ATOMIC_RELAXED);
+}
+
+void chunk_sched_set_weight(struct chunk_sched * const sched, const unsigned int queue, const double weight)
+{
+	if (queue >= sched->nb_queues || !(weight > 0))
+		return;
+
+	pthread_mutex_lock(&sched->refill);
+	sched->weights[queue] = weight;
+	pthread_mutex_unlock(&sched->refill);
+}
+
+void chunk_sched_copy_weights(struct chunk_sched * const dst, struct chunk_sched * const src)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&src->refill);
+	pthread_mutex_lock(&dst->refill);
+	for (i=0 ; i<min(dst->nb_queues, src->nb_queues) ; i++)
+		dst->weights[i] = src->weights[i];
+	pthread_mutex_unlock(&dst->refill);
+	pthread_mutex_unlock(&src->refill);
+}
+
+unsigned long int chunk_sched_pass(struct chunk_sched const * const sched)
+{
+	return __atomic_load_n(&sched->pass, __ATOMIC_RELAXED);
+}
+
+unsigned int chunk_sched_covered(struct chunk_sched const * const sched)
+{
+	return __atomic_load_n(&sched->covered, __ATOMIC_RELAXED);
+}
+
+static int cmp_desc(void const * const a, void const * const b)
+{
+	return *(uint8_t const*)b - *(uint8_t const*)a;
+}
+
+unsigned int chunk_sched_coverage(struct chunk_sched const * const sched, const unsigned int nb_slots)
+{
+	uint8_t *mins;
+	unsigned int slot, r;
+	size_t chunk;
+
+	if (!nb_slots || nb_slots > sched->nb_slots)
+		return 0;
+
+	mins = malloc(sched->nb_slots);
+	if (!mins)
+		return 0;
+
+	for (slot=0 ; slot<sched->nb_slots ; slot++) {
+		uint8_t const * const counters = &sched->coverage[(size_t)slot*sched->nb_chunks];
+		mins[slot] = CHUNKS_MAX_COVERAGE;
+		for (chunk=0 ; chunk<sched->nb_chunks ; chunk++)
+			if (__atomic_load_n(&counters[chunk], __ATOMIC_RELAXED) < mins[slot])
+				mins[slot] = __atomic_load_n(&counters[chunk], __ATOMIC_RELAXED);
+	}
+
+	qsort(mins, sched->nb_slots, 1, cmp_desc);
+	r = mins[nb_slots-1];
+	free(mins);
+
+	return r;
+}
@@ -0,0 +1,57 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#ifndef CHUNKS_H
+#define CHUNKS_H
+
+#include <stddef.h>
+
+/* Highest coverage that can be tracked, counters are bytes */
+#define CHUNKS_MAX_COVERAGE 255
+
+/* Hands out the table in chunks, so that each pass checks every element
+ * once. Each queue gets a contiguous share of the chunks, proportional to its
+ * weight and rotated at each pass, and steals from the other queues once its
+ * own is empty.
+ *
+ * Coverage is counted per chunk and per slot (a cpu), a slot being covered
+ * once each of its chunks was checked at least target times. */
+struct chunk_sched;
+
+struct chunk_sched * chunk_sched_new(const size_t table_size, const size_t chunk_size,
+		const unsigned int nb_queues, const unsigned int nb_slots, const unsigned int target);
+void chunk_sched_delete(struct chunk_sched * const sched);
+
+/* Any number of threads may share a queue. Returns the chunk number. */
+size_t chunk_sched_next(struct chunk_sched * const sched, const unsigned int queue, size_t * const start, size_t * const count);
+/* slot may be -1 if unknown */
+void chunk_sched_done(struct chunk_sched * const sched, const size_t chunk, const int slot);
+
+/* Weights default to 1 and apply from the next pass on, so that queues fed
+ * by faster cores get a larger share */
+void chunk_sched_set_weight(struct chunk_sched * const sched, const unsigned int queue, const double weight);
+/* Gives the queues of dst the weights of the ones of src, for schedulers of
+ * successive tables */
+void chunk_sched_copy_weights(struct chunk_sched * const dst, struct chunk_sched * const src);
+
+/* Number of passes started, every chunk of the previous ones was handed out */
+unsigned long int chunk_sched_pass(struct chunk_sched const * const sched);
+/* Number of slots that reached the target */
+unsigned int chunk_sched_covered(struct chunk_sched const * const sched);
+/* Highest coverage reached by at least nb_slots slots */
+unsigned int chunk_sched_coverage(struct chunk_sched const * const sched, const unsigned int nb_slots);
+
+#endif
@@ -0,0 +1,184 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "control.h"
+
+#define POLL_TIMEOUT_MS 200
+#define LINE_MAX_SIZE 256
+
+struct control {
+	pthread_t thread;
+	int fd;
+	char *path;
+	control_handler handler;
+	void *ctx;
+	volatile int should_exit;
+};
+
+/* Returns when the client disconnects or the control is stopped */
+static void serve_client(struct control * const ctl, const int fd)
+{
+	char buf[LINE_MAX_SIZE];
+	size_t len = 0;
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	FILE *reply;
+	int dupfd;
+
+	dupfd = dup(fd);
+	if (dupfd == -1)
+		return;
+	reply = fdopen(dupfd, "w");
+	if (!reply) {
+		close(dupfd);
+		return;
+	}
+
+	while (!ctl->should_exit) {
+		char *eol;
+		ssize_t r;
+
+		if (poll(&pfd, 1, POLL_TIMEOUT_MS) <= 0)
+			continue;
+
+		r = read(fd, buf+len, sizeof(buf)-1-len);
+		if (r <= 0)
+			break;
+		len += r;
+
+		while ((eol = memchr(buf, '\n', len))) {
+			*eol = '\0';
+			if (eol > buf && eol[-1] == '\r')
+				eol[-1] = '\0';
+			ctl->handler(ctl->ctx, buf, reply);
+			fflush(reply);
+			len -= eol+1-buf;
+			memmove(buf, eol+1, len);
+		}
+
+		if (len == sizeof(buf)-1) {
+			fprintf(reply, "error: line too long\n");
+			fflush(reply);
+			len = 0;
+		}
+	}
+
+	fclose(reply);
+}
+
+static void * control_func(void *arg)
+{
+	struct control * const ctl = arg;
+	struct pollfd pfd = { .fd = ctl->fd, .events = POLLIN };
+
+	while (!ctl->should_exit) {
+		int fd;
+
+		if (poll(&pfd, 1, POLL_TIMEOUT_MS) <= 0)
+			continue;
+
+		fd = accept(ctl->fd, NULL, NULL);
+		if (fd == -1)
+			continue;
+		serve_client(ctl, fd);
+		close(fd);
+	}
+
+	return NULL;
+}
+
+struct control * control_start(char const * const path, const control_handler handler, void * const ctx)
+{
+	struct control *ctl;
+	struct sockaddr_un addr;
+	struct sigaction sa;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Control socket path %s is too long\n", path);
+		return NULL;
+	}
+
+	ctl = malloc(sizeof(*ctl));
+	if (!ctl) {
+		fprintf(stderr, "Could not allocate control state\n");
+		return NULL;
+	}
+	ctl->handler = handler;
+	ctl->ctx = ctx;
+	ctl->should_exit = 0;
+	ctl->path = strdup(path);
+	if (!ctl->path) {
+		fprintf(stderr, "Could not allocate control state\n");
+		goto err_ctl;
+	}
+
+	ctl->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (ctl->fd == -1) {
+		fprintf(stderr, "Could not create control socket\n");
+		goto err_path;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+	if (bind(ctl->fd, (struct sockaddr*)&addr, sizeof(addr)) || listen(ctl->fd, 4)) {
+		fprintf(stderr, "Could not listen on control socket %s: %s\n", path, strerror(errno));
+		goto err_fd;
+	}
+
+	/* Clients going away must not kill the run */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &sa, NULL);
+
+	if (pthread_create(&ctl->thread, NULL, control_func, ctl)) {
+		fprintf(stderr, "Issue when spawning control thread\n");
+		goto err_unlink;
+	}
+
+	return ctl;
+
+err_unlink:
+	unlink(path);
+err_fd:
+	close(ctl->fd);
+err_path:
+	free(ctl->path);
+err_ctl:
+	free(ctl);
+	return NULL;
+}
+
+void control_stop(struct control * const ctl)
+{
+	ctl->should_exit = 1;
+	pthread_join(ctl->thread, NULL);
+	close(ctl->fd);
+	unlink(ctl->path);
+	free(ctl->path);
+	free(ctl);
+}
@@ -0,0 +1,33 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdio.h>
+
+/* Called from the control thread for each line received, without the
+ * trailing newline. Replies are written to reply. */
+typedef void (*control_handler)(void * const ctx, char const * const line, FILE *reply);
+
+struct control;
+
+/* Serves a Unix domain stream socket bound on path from a side thread,
+ * one client at a time, until control_stop() */
+struct control * control_start(char const * const path, const control_handler handler, void * const ctx);
+void control_stop(struct control * const ctl);
+
+#endif
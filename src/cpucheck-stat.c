@@ -0,0 +1,196 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "stats.h"
+
+static struct stats_thread const * thread_slot(struct stats_page const * const page, const uint32_t tno)
+{
+	return (struct stats_thread const *) ((char const *)page->threads + (size_t)tno*page->thread_size);
+}
+
+/* Prints unknown values as - */
+static void print_sensors_text(FILE *out, struct sensor_sample const * const s)
+{
+	if (s->mhz)
+		fprintf(out, "\t%" PRIu32, s->mhz);
+	else
+		fprintf(out, "\t-");
+	if (s->core_temp != SENSOR_TEMP_UNKNOWN)
+		fprintf(out, "\t%.1f", s->core_temp/1000.);
+	else
+		fprintf(out, "\t-");
+	if (s->package_temp != SENSOR_TEMP_UNKNOWN)
+		fprintf(out, "\t%.1f", s->package_temp/1000.);
+	else
+		fprintf(out, "\t-");
+	if (s->core_throttles != SENSOR_COUNT_UNKNOWN)
+		fprintf(out, "\t%" PRIu64, s->core_throttles);
+	else
+		fprintf(out, "\t-");
+	if (s->package_throttles != SENSOR_COUNT_UNKNOWN)
+		fprintf(out, "\t%" PRIu64, s->package_throttles);
+	else
+		fprintf(out, "\t-");
+}
+
+/* Prints unknown values as null */
+static void print_sensors_json(FILE *out, struct sensor_sample const * const s)
+{
+	fprintf(out, ",\"sample_ns\":%" PRIu64, s->ns);
+	if (s->mhz)
+		fprintf(out, ",\"mhz\":%" PRIu32, s->mhz);
+	else
+		fprintf(out, ",\"mhz\":null");
+	if (s->core_temp != SENSOR_TEMP_UNKNOWN)
+		fprintf(out, ",\"core_temp\":%.3f", s->core_temp/1000.);
+	else
+		fprintf(out, ",\"core_temp\":null");
+	if (s->package_temp != SENSOR_TEMP_UNKNOWN)
+		fprintf(out, ",\"package_temp\":%.3f", s->package_temp/1000.);
+	else
+		fprintf(out, ",\"package_temp\":null");
+	if (s->core_throttles != SENSOR_COUNT_UNKNOWN)
+		fprintf(out, ",\"core_throttles\":%" PRIu64, s->core_throttles);
+	else
+		fprintf(out, ",\"core_throttles\":null");
+	if (s->package_throttles != SENSOR_COUNT_UNKNOWN)
+		fprintf(out, ",\"package_throttles\":%" PRIu64, s->package_throttles);
+	else
+		fprintf(out, ",\"package_throttles\":null");
+}
+
+static void print_text(FILE *out, struct stats_page const * const page, const uint32_t nb_threads)
+{
+	struct stats_thread t;
+	uint32_t tno;
+
+	fprintf(out, "pid %" PRId64 ", checker %.*s, table size %" PRIu64 ", %" PRIu32 " threads\n",
+			page->pid, STATS_NAME_SIZE, page->checker, page->table_size, nb_threads);
+	fprintf(out, "thread\tcpu\tchecker\tchecks\terrors\tlast_error_ns%s\n",
+			page->version >= 2 ? "\tmhz\tcore_temp\tpackage_temp\tcore_throttles\tpackage_throttles" : "");
+	for (tno=0 ; tno<nb_threads ; tno++) {
+		if (stats_read_thread(&t, thread_slot(page, tno), page->version)) {
+			fprintf(out, "%" PRIu32 "\tbusy\n", tno);
+			continue;
+		}
+		fprintf(out, "%" PRIu32 "\t%" PRId32 "\t%s\t%" PRIu64 "\t%" PRIu64 "\t%" PRIu64,
+				tno, t.cpu, t.checker, t.checks, t.errors, t.last_error_ns);
+		if (page->version >= 2)
+			print_sensors_text(out, &t.sensors);
+		fprintf(out, "\n");
+	}
+}
+
+static void print_json(FILE *out, struct stats_page const * const page, const uint32_t nb_threads)
+{
+	struct stats_thread t;
+	uint32_t tno;
+
+	fprintf(out, "{\"version\":%" PRIu32 ",\"pid\":%" PRId64 ",\"start_ns\":%" PRIu64
+			",\"checker\":\"%.*s\",\"table_size\":%" PRIu64 ",\"threads\":[",
+			page->version, page->pid, page->start_ns, STATS_NAME_SIZE, page->checker, page->table_size);
+	for (tno=0 ; tno<nb_threads ; tno++) {
+		if (stats_read_thread(&t, thread_slot(page, tno), page->version)) {
+			fprintf(out, "%s{\"thread\":%" PRIu32 ",\"busy\":true}", tno ? "," : "", tno);
+			continue;
+		}
+		fprintf(out, "%s{\"thread\":%" PRIu32 ",\"cpu\":%" PRId32 ",\"checker\":\"%s\",\"checks\":%" PRIu64
+				",\"errors\":%" PRIu64 ",\"last_error_ns\":%" PRIu64,
+				tno ? "," : "", tno, t.cpu, t.checker, t.checks, t.errors, t.last_error_ns);
+		if (page->version >= 2)
+			print_sensors_json(out, &t.sensors);
+		fprintf(out, "}");
+	}
+	fprintf(out, "]}\n");
+}
+
+static void print_usage(char const * const progname)
+{
+	fprintf(stderr, "Usage: %s [-j] <name>\n", progname);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "\t-j: Prints as JSON\n");
+	fprintf(stderr, "\tname: Statistics page given to cpucheck -S\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct stats_page const *page;
+	char const *name;
+	struct stat st;
+	uint32_t nb_threads;
+	int opt, json = 0, fd;
+
+	while ((opt = getopt(argc, argv, "hj")) != -1) {
+		switch(opt) {
+			case 'j':
+				json = 1;
+				break;
+			default:
+				print_usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+	if (optind != argc-1) {
+		print_usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	name = argv[optind];
+
+	fd = STATS_IS_SHM(name) ? shm_open(name, O_RDONLY, 0) : open(name, O_RDONLY);
+	if (fd == -1 || fstat(fd, &st)) {
+		fprintf(stderr, "Could not open statistics page %s\n", name);
+		return EXIT_FAILURE;
+	}
+	if ((size_t)st.st_size < sizeof(*page)) {
+		fprintf(stderr, "%s is too small to be a statistics page\n", name);
+		return EXIT_FAILURE;
+	}
+
+	page = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (page == MAP_FAILED) {
+		fprintf(stderr, "Could not map statistics page %s\n", name);
+		return EXIT_FAILURE;
+	}
+
+	if (__atomic_load_n(&page->magic, __ATOMIC_ACQUIRE) != STATS_MAGIC || page->version < 1
+			|| page->thread_size < (page->version >= 2 ? sizeof(struct stats_thread) : offsetof(struct stats_thread, sensors))
+			|| sizeof(*page) + (size_t)page->capacity*page->thread_size > (size_t)st.st_size) {
+		fprintf(stderr, "%s is not a supported statistics page\n", name);
+		return EXIT_FAILURE;
+	}
+
+	nb_threads = __atomic_load_n(&page->nb_threads, __ATOMIC_ACQUIRE);
+	if (nb_threads > page->capacity)
+		nb_threads = page->capacity;
+
+	if (json)
+		print_json(stdout, page, nb_threads);
+	else
+		print_text(stdout, page, nb_threads);
+
+	return EXIT_SUCCESS;
+}
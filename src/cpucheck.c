@@ -24,12 +24,58 @@
 #include <unistd.h>
 #include <string.h>
 #include <signal.h>
+#include <time.h>
+#include <math.h>
+#include <getopt.h>
 #if HAVE_SCHED_H
 #include <sched.h>
 #endif
-#include "cpucheck.h"
+#include "libcpucheck.h"
+#include "topology.h"
+#include "c2c.h"
+#include "litmus.h"
+#include "smt.h"
+#include "stats.h"
+#include "control.h"
+#include "governor.h"
+#include "chunks.h"
+#include "sensors.h"
+#include "burst.h"
+#include "triage.h"
+#include "signatures.h"
+#include "procs.h"
+#include "outliers.h"
+#include "sweep.h"
 
 #define min(a, b) ((a)<(b)?(a):(b))
+#define max(a, b) ((a)>(b)?(a):(b))
+
+#define C2C_ROUNDTRIPS 20000
+#define LITMUS_ITERATIONS (1UL<<20)
+#define SMT_PHASE_SECONDS 2
+#define SWEEP_STEP_SECONDS 2
+/* Checks between two looks at the shared state and statistics page updates,
+ * and size of the chunks the table is handed out in */
+#define WORKER_BATCH 4096
+/* Checks between two looks at the clock during bursts */
+#define BURST_STEP 256
+/* Longest idle wait before looking at the shared state again */
+#define BURST_MAX_WAIT_NS 100000000
+/* Period of machine context sampling by each checker thread */
+#define SENSORS_PERIOD_NS 1000000000
+/* Time spent re-verifying table checksums per monitor tick */
+#define SCRUB_BUDGET_NS 1000000
+#define SELFTEST_INJECTIONS 200
+/* Injections not reported within that delay are counted as missed */
+#define SELFTEST_TIMEOUT_NS 10000000000ULL
+/* Period of error signature summaries, once full reports are exhausted */
+#define SIGNATURES_PERIOD_NS 10000000000ULL
+/* Cpus whose rate is compared to their peers, and smallest relative deviation
+ * from their median flagged, so that tightly grouped rates do not raise noise */
+#define STRAGGLER_MIN_PEERS 3
+#define STRAGGLER_MIN_DEVIATION 0.05
+/* Checks of the reproduced element between two looks at the stop flag */
+#define REPLAY_BATCH 65536
 
 static volatile int *should_stop;
 
@@ -39,95 +85,84 @@ static void shouldstop_sig_handler(int signum)
 		*should_stop = 1;
 }
 
-extern struct cpucheck_checker cpucheck_checker_addsub;
-#if ARCH_X86_64
-extern struct cpucheck_checker cpucheck_checker_bitscan;
-extern struct cpucheck_checker cpucheck_checker_bittest;
-#endif
-extern struct cpucheck_checker cpucheck_checker_bool;
-#if ARCH_X86_64
-extern struct cpucheck_checker cpucheck_checker_cmps;
-extern struct cpucheck_checker cpucheck_checker_cmpxchg;
-extern struct cpucheck_checker cpucheck_checker_lea;
-extern struct cpucheck_checker cpucheck_checker_lodsstos;
-extern struct cpucheck_checker cpucheck_checker_lzcnt;
-#endif
-extern struct cpucheck_checker cpucheck_checker_muldiv;
-#if ARCH_X86_64
-extern struct cpucheck_checker cpucheck_checker_signextend;
-#endif
-
-static struct cpucheck_checker const * const checkers[] = {
-	&cpucheck_checker_addsub,
-#if ARCH_X86_64
-	&cpucheck_checker_bitscan,
-	&cpucheck_checker_bittest,
-#endif
-	&cpucheck_checker_bool,
-#if ARCH_X86_64
-	&cpucheck_checker_cmps,
-	&cpucheck_checker_cmpxchg,
-	&cpucheck_checker_lea,
-	&cpucheck_checker_lodsstos,
-	&cpucheck_checker_lzcnt,
-#endif
-	&cpucheck_checker_muldiv,
-#if ARCH_X86_64
-	&cpucheck_checker_signextend,
-#endif
-	NULL
-};
-
-#define NIBLE_COUNT(tofill, niblesz) ( (tofill)/(niblesz) + !!((tofill)%(niblesz)) )
-
-unsigned long int ulirandom(void)
+/* Sets *flag on SIGINT, or once duration seconds elapsed if not null */
+static void install_stop_handler(volatile int * const flag, const unsigned int duration)
 {
-	size_t i;
-	unsigned long int res;
-
-	for(i=res=0 ; i<NIBLE_COUNT(sizeof(unsigned long int)*8, RANDOM_NIBLE_SIZE) ; i++)
-		res |= random() << (i*RANDOM_NIBLE_SIZE);
-
-	return res;
-}
-
-uint64_t u64random(void)
-{
-	size_t i;
-	uint64_t res;
-
-	for(i=res=0 ; i<NIBLE_COUNT(sizeof(uint64_t)*8, RANDOM_NIBLE_SIZE) ; i++)
-		res |= (uint64_t) random() << (i*RANDOM_NIBLE_SIZE);
+	struct sigaction sa;
 
-	return res;
+	should_stop = flag;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = shouldstop_sig_handler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGALRM, &sa, NULL);
+	alarm(duration);
 }
 
-void hex_dump(FILE *out, char const * const what, char const * const todump, const size_t len)
-{
-	size_t i;
-
-	if (what)
-		fprintf(out, "%s\n", what);
-
-	for(i=0 ; i<len ; i++) {
-		if (!(i%16))
-			fprintf(out, "%04zx: ", i);
-
-		fprintf(out, "%02hhx ", *(todump+i));
+enum mode {
+	MODE_CHECK,
+	MODE_C2C,
+	MODE_LITMUS,
+	MODE_PROCS,
+	MODE_SELFTEST,
+	MODE_SMT,
+	MODE_SWEEP,
+};
 
-		if (i%8 == 7) {
-			fprintf(out, i%16 == 7 ? " " : "\n");
-		}
-	}
+static struct {
+	char const * const name;
+	char const * const description;
+} const modes[] = {
+	[MODE_CHECK] = { "check", "Checks the table over and over again until interrupted" },
+	[MODE_C2C] = { "c2c", "Measures core to core cache line latency and checks transferred data" },
+	[MODE_LITMUS] = { "litmus", "Runs x86-TSO memory ordering litmus tests on every pair of cpus until interrupted" },
+	[MODE_PROCS] = { "procs", "Checks the table from one pinned process per cpu, so that a fault signal only stops\n"
+			"\t\tone cpu, and restarts killed processes (see -x) until interrupted" },
+	[MODE_SELFTEST] = { "selftest", "Flips bits of expected results in the table, one at a time, and measures how long\n"
+			"\t\tchecker threads take to report them" },
+	[MODE_SMT] = { "smt", "Runs complementary checkers on the SMT siblings of each core, and compares their\n"
+			"\t\tthroughput to running alone (a third of duration per phase)" },
+	[MODE_SWEEP] = { "sweep", "Checks the table with 1, 2, 4, ... up to nbThreads pinned threads, cores first, then\n"
+			"\t\tSMT siblings, then other packages, and reports the throughput curve (duration is split\n"
+			"\t\tbetween steps)" },
+};
 
-	if (len%16)
-		fprintf(out, "\n");
-}
+/* Table walk, page walks derive their stride from the element size */
+struct walk {
+	char const * name;
+	enum cpucheck_walk order;
+	size_t stride;
+	size_t page;
+	size_t prefetch;
+};
 
 struct args {
 	unsigned long table_size;
 	unsigned int nb_threads;
 	struct cpucheck_checker const * checker;
+	enum mode mode;
+	int pin;
+	int compact;
+	unsigned int duration;
+	char const * stats_name;
+	char const * control_path;
+	int background;
+	int nice;
+	unsigned int budget;
+	unsigned int coverage;
+	unsigned int repeat;
+	int regen;
+	/* Rechecks of failing elements by the triage thread, 0 disables it */
+	unsigned long int triage;
+	/* Full inconsistency reports printed before only summarising them */
+	unsigned long int reports;
+	char const * replay;
+	int replay_cpu;
+	/* Leave out cpus whose process died in procs mode */
+	int exclude;
+	/* Straggler detection window in seconds, 0 disables it */
+	unsigned int window;
+	struct burst burst;
+	struct walk walk;
 };
 
 static unsigned int get_core_count(void)
@@ -147,218 +182,1641 @@ static void args_init(struct args * const args)
 {
 	args->table_size = 65535;
 	args->nb_threads = get_core_count();
-	args->checker = checkers[0];
+	args->checker = cpucheck_checkers()[0];
+	args->mode = MODE_CHECK;
+	args->pin = 0;
+	args->compact = 0;
+	args->duration = 0;
+	args->stats_name = NULL;
+	args->control_path = NULL;
+	args->background = 0;
+	args->nice = 0;
+	args->budget = 100;
+	args->coverage = 0;
+	args->repeat = 1;
+	args->regen = 0;
+	args->triage = 0;
+	args->reports = 10;
+	args->replay = NULL;
+	args->replay_cpu = -1;
+	args->exclude = 0;
+	args->window = 10;
+	args->burst.period = 0;
+	args->walk.name = "seq";
+	args->walk.order = CPUCHECK_WALK_SEQ;
+	args->walk.prefetch = 0;
 }
 
 struct thread_state {
 	pthread_t thread;
+	unsigned int tno;
+	int cpu;
 	struct state * state;
-	size_t start_idx;
-	void *comp;
-	unsigned long int inconsistencies;
-	unsigned long int checks;
+	struct cpucheck_worker *worker;
+	volatile int should_exit;
+	uint64_t last_error_ns;
+	struct stats_thread *stats;
+	double cpu_usage;
+	int slot;
+	/* Latest machine context, only touched by the thread itself */
+	struct sensor_sample sample;
+	/* Chunk being checked and elements left, a chunk may span several
+	 * bursts */
+	size_t chunk;
+	size_t left;
+	uint64_t burst_start;
+	/* Checks at the start of the straggler detection window, and rate
+	 * over the last one, negative if not pinned */
+	unsigned long int window_checks;
+	double window_rate;
+	uint64_t start_ns;
+	/* Table generation the worker checks, and the scheduler of that table */
+	unsigned long int epoch;
+	struct chunk_sched *sched;
 };
 
+/* Workers only look at epoch and pauses between batches of WORKER_BATCH
+ * checks. table is swapped either while every worker is parked, or by the
+ * regeneration thread, in which case workers move to the new table at their
+ * next chunk and the previous one is kept as stale until they all did.
+ * Threads are only removed while every worker is parked; ctl protects
+ * everything below it. */
 struct state {
-	void *checker_conf;
-	size_t table_size;
-	void * table;
-	struct cpucheck_checker const * const checker;
-	struct thread_state *threads;
+	struct cpucheck_table *table;
+	struct chunk_sched *sched;
+	unsigned long int epoch;
 	volatile int should_exit;
+	unsigned int pauses;
 	pthread_mutex_t output;
+	struct stats_page *stats;
+	struct cpu_topo *cpus;
+	unsigned int cpu_count;
+	int pin;
+	/* Switch to compact variants of checkers */
+	int compact;
+	unsigned int coverage;
+	/* Index in cpus of each cpu number, -1 if not allowed */
+	int *cpu_slots;
+	unsigned int cpu_slots_size;
+	pthread_mutex_t ctl;
+	pthread_cond_t ctl_cond;
+	struct thread_state **threads;
+	unsigned int nb_threads;
+	unsigned int parked;
+	int user_paused;
+	unsigned long int retired_inconsistencies;
+	unsigned long int retired_checks;
+	double retired_usage;
+	unsigned int retired_threads;
+	/* Checks and lifetimes of retired pinned threads, per core type */
+	unsigned long int type_checks[CORE_TYPE_COUNT];
+	double type_seconds[CORE_TYPE_COUNT];
+	unsigned int type_threads[CORE_TYPE_COUNT];
+	/* Self-test: element holding the injected fault, when it was first
+	 * reported, and how many reports it caused */
+	void const *injected;
+	uint64_t detected_ns;
+	unsigned long int injected_reports;
+	/* Inconsistencies on elements whose slice fails its checksum */
+	unsigned long int table_corruptions;
+	/* Scrubbing state of scrub_table, only used from the monitor loop */
+	struct cpucheck_table const *scrub_table;
+	uint8_t *scrub_reported;
+	size_t scrub_cursor;
+	unsigned long int corrupted_slices;
+	int background;
+	int nice;
+	unsigned int budget;
+	/* Bursty load if period is not null */
+	struct burst const *burst;
+	struct walk const *walk;
+	/* Checks of each element in a row */
+	unsigned int repeat;
+	struct cpucheck_table *stale_table;
+	struct chunk_sched *stale_sched;
+	unsigned long int regenerations;
+	/* May be NULL */
+	struct triage *triage;
+	struct signatures *signatures;
+	/* Full reports left, written with output held */
+	unsigned long int reports;
+	/* Straggler detection, only used from the monitor loop. Rates are
+	 * compared once per window, per cpu slot, between cpus of the same core
+	 * type. Chunks are handed out in proportion to the rate of each
+	 * thread. */
+	uint64_t window_ns;
+	uint64_t window_start;
+	unsigned int window_threads;
+	struct cpucheck_checker const *window_checker;
+	struct straggler *stragglers;
+	double *rates;
+	double *peer_rates;
+	double *scores;
+	unsigned int *rated_slots;
+};
+
+struct straggler {
+	unsigned int windows;
+	unsigned int flagged;
+	/* Rate relative to the median of peers farthest from 1 */
+	double worst;
 };
 
+static uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+static void publish_stats(struct thread_state const * const thrd)
+{
+	if (thrd->stats)
+		stats_publish(thrd->stats, thrd->cpu, cpucheck_worker_checks(thrd->worker),
+				cpucheck_worker_inconsistencies(thrd->worker), thrd->last_error_ns,
+				cpucheck_table_checker(cpucheck_worker_table(thrd->worker))->name, &thrd->sample);
+}
+
+static void on_error(void * const ctx, struct cpucheck_worker const * const worker,
+		void const * const table_element, void const * const comp)
+{
+	struct thread_state * const thrd = ctx;
+	struct cpucheck_table const * const table = cpucheck_worker_table(worker);
+	const int report = !!__atomic_load_n(&thrd->state->reports, __ATOMIC_RELAXED);
+	uint64_t none = 0;
+	int corrupted, cpu;
+
+	if (table_element == __atomic_load_n(&thrd->state->injected, __ATOMIC_ACQUIRE)) {
+		__atomic_compare_exchange_n(&thrd->state->detected_ns, &none, monotonic_ns(), 0,
+				__ATOMIC_RELEASE, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&thrd->state->injected_reports, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	/* A corrupted element would fail on any cpu. Past full reports, slices
+	 * are only verified once, and then again by the scrubber, so that each
+	 * inconsistency costs the same. */
+	corrupted = report ? cpucheck_table_verify_element(table, table_element)
+		: cpucheck_table_verify_element_cached(table, table_element);
+	if (corrupted)
+		__atomic_add_fetch(&thrd->state->table_corruptions, 1, __ATOMIC_RELAXED);
+
+	cpu = thrd->cpu != -1 ? thrd->cpu : topology_current_cpu();
+	if (!corrupted)
+		signatures_add(thrd->state->signatures, table, table_element, comp, cpu);
+	if (report)
+		pthread_mutex_lock(&thrd->state->output);
+	if (report && thrd->state->reports) {
+		__atomic_store_n(&thrd->state->reports, thrd->state->reports-1, __ATOMIC_RELAXED);
+		cpucheck_report_error(stderr, worker, table_element, comp);
+		if (corrupted)
+			fprintf(stderr, "Table corrupted: the element does not match its checksum anymore\n");
+		else
+			fprintf(stderr, "Compute mismatch on cpu %d\n", cpu);
+		sensors_print(stderr, &thrd->sample);
+		if (thrd->state->burst->period)
+			fprintf(stderr, "%.3f ms after burst start\n", (monotonic_ns() - thrd->burst_start)/1e6);
+		if (!thrd->state->reports)
+			fprintf(stderr, "Further inconsistencies are only summarised by error signature\n");
+	}
+	if (report)
+		pthread_mutex_unlock(&thrd->state->output);
+
+	if (thrd->state->triage)
+		triage_submit(thrd->state->triage, table, table_element, cpu);
+
+	if (thrd->stats) {
+		thrd->last_error_ns = stats_now_ns();
+		publish_stats(thrd);
+	}
+}
+
+/* Coverage is accounted to the cpu a chunk ends on when not pinned */
+static int current_slot(struct thread_state const * const thrd)
+{
+	struct state const * const state = thrd->state;
+	int cpu;
+
+	if (thrd->slot != -1)
+		return thrd->slot;
+	if (!state->cpu_slots)
+		return 0;
+
+	cpu = topology_current_cpu();
+	if (cpu < 0 || (unsigned int)cpu >= state->cpu_slots_size)
+		return -1;
+	return state->cpu_slots[cpu];
+}
+
+/* Parks the worker while a pause is requested. Exited workers stay counted
+ * as parked until they are joined. */
+static void park(struct thread_state * const thrd, const int exiting)
+{
+	struct state * const state = thrd->state;
+
+	pthread_mutex_lock(&state->ctl);
+	state->parked++;
+	pthread_cond_broadcast(&state->ctl_cond);
+	if (!exiting) {
+		while (state->pauses && !state->should_exit && !thrd->should_exit)
+			pthread_cond_wait(&state->ctl_cond, &state->ctl);
+		state->parked--;
+	}
+	pthread_mutex_unlock(&state->ctl);
+}
+
+/* Moves to the latest table, the current chunk must be done */
+static void follow_table(struct thread_state * const thrd)
+{
+	struct state * const state = thrd->state;
+	const unsigned long int epoch = __atomic_load_n(&state->epoch, __ATOMIC_ACQUIRE);
+
+	if (epoch == thrd->epoch)
+		return;
+
+	/* Regenerated tables use the same checker, so this cannot fail */
+	cpucheck_worker_set_table(thrd->worker, __atomic_load_n(&state->table, __ATOMIC_RELAXED));
+	thrd->sched = __atomic_load_n(&state->sched, __ATOMIC_RELAXED);
+	__atomic_store_n(&thrd->epoch, epoch, __ATOMIC_RELEASE);
+}
+
 static void * thread_func(void *arg)
 {
 	struct thread_state * const thrd = arg;
-	size_t idx;
-	unsigned short int start;
-
-	for (start=1 ; !thrd->state->should_exit ; start=0) {
-		for (idx = start ? thrd->start_idx : 0 ; idx<thrd->state->table_size && !thrd->state->should_exit ; idx++) {
-			void const * const elt = (char*)thrd->state->table + idx*thrd->state->checker->table_elt_size;
-			if (thrd->state->checker->check_item(thrd->comp, thrd->state->checker_conf, elt)) {
-				pthread_mutex_lock(&thrd->state->output);
-				fprintf(stderr, "Inconsistency detected...\n");
-				if (thrd->state->checker->report_error)
-					thrd->state->checker->report_error(stderr, thrd->state->checker_conf, elt, thrd->comp);
-				pthread_mutex_unlock(&thrd->state->output);
-				if (ULONG_MAX-thrd->inconsistencies)
-					thrd->inconsistencies++;
+	struct state * const state = thrd->state;
+	struct governor gov;
+	struct sensors *sensors;
+	size_t start, count;
+	uint64_t next_sample = 0, now;
+
+	if ((state->background || state->nice) && set_thread_priority(state->background, state->nice)) {
+		pthread_mutex_lock(&state->output);
+		fprintf(stderr, "Thread %u keeps its default priority\n", thrd->tno);
+		pthread_mutex_unlock(&state->output);
+	}
+
+	governor_init(&gov, state->budget);
+	sensors = sensors_new();
+
+	while (!state->should_exit && !thrd->should_exit) {
+		if (__atomic_load_n(&state->pauses, __ATOMIC_ACQUIRE)) {
+			park(thrd, 0);
+			continue;
+		}
+
+		if (sensors && (now = monotonic_ns()) >= next_sample) {
+			sensors_sample(sensors, thrd->cpu, &thrd->sample);
+			next_sample = now + SENSORS_PERIOD_NS;
+		}
+
+		if (state->burst->period) {
+			thrd->burst_start = burst_wait(state->burst, BURST_MAX_WAIT_NS);
+			if (!thrd->burst_start)
+				continue;
+		}
+
+		if (!thrd->left) {
+			follow_table(thrd);
+			thrd->chunk = chunk_sched_next(thrd->sched, thrd->tno, &start, &thrd->left);
+			cpucheck_worker_seek(thrd->worker, start);
+		}
+
+		if (state->burst->period) {
+			for ( ; thrd->left && burst_active(state->burst, thrd->burst_start) ; thrd->left -= count) {
+				count = min(thrd->left, BURST_STEP);
+				cpucheck_worker_step(thrd->worker, count);
 			}
-			if (thrd->checks < ULONG_MAX)
-				thrd->checks++;
+		} else {
+			cpucheck_worker_step(thrd->worker, thrd->left);
+			thrd->left = 0;
 		}
+
+		if (!thrd->left)
+			chunk_sched_done(thrd->sched, thrd->chunk, current_slot(thrd));
+		publish_stats(thrd);
+		if (state->budget < 100)
+			governor_throttle(&gov);
 	}
 
+	thrd->cpu_usage = governor_usage(&gov);
+	if (sensors)
+		sensors_delete(sensors);
+	park(thrd, 1);
+
 	return NULL;
 }
 
-static int init_state(struct state *state, struct args const * const args)
+/* Waits for every worker to be parked */
+static void pause_workers(struct state * const state)
 {
-	unsigned int tno;
+	pthread_mutex_lock(&state->ctl);
+	__atomic_add_fetch(&state->pauses, 1, __ATOMIC_ACQ_REL);
+	while (state->parked < state->nb_threads)
+		pthread_cond_wait(&state->ctl_cond, &state->ctl);
+	pthread_mutex_unlock(&state->ctl);
+}
+
+static void resume_workers(struct state * const state)
+{
+	pthread_mutex_lock(&state->ctl);
+	__atomic_sub_fetch(&state->pauses, 1, __ATOMIC_ACQ_REL);
+	pthread_cond_broadcast(&state->ctl_cond);
+	pthread_mutex_unlock(&state->ctl);
+}
+
+/* Must be called with ctl held */
+static int add_thread(struct state * const state)
+{
+	struct thread_state *thrd, **threads;
+	const unsigned int tno = state->nb_threads;
 
-	if (SIZE_MAX/args->checker->table_elt_size < args->table_size) {
-		fprintf(stderr, "Requested table size is too big\n");
+	if (tno == UINT_MAX || SIZE_MAX/sizeof(*state->threads) <= tno) {
+		fprintf(stderr, "Requested thread count is too big\n");
 		return -1;
 	}
-	if (SIZE_MAX/sizeof(*state->threads) < args->nb_threads) {
-		fprintf(stderr, "Requested thread count is too big\n");
+
+	threads = realloc(state->threads, sizeof(*state->threads) * (tno+1));
+	if (!threads) {
+		fprintf(stderr, "Could not allocate threads states\n");
 		return -1;
 	}
+	state->threads = threads;
 
-	state->checker_conf = malloc(args->checker->config_size);
-	if (!state->checker_conf) {
-		fprintf(stderr,"Could not allocate checker config\n");
+	thrd = malloc(sizeof(*thrd));
+	if (!thrd) {
+		fprintf(stderr, "Could not allocate thread state\n");
 		return -1;
 	}
+	thrd->tno = tno;
+	thrd->state = state;
+	thrd->cpu = state->pin ? state->cpus[tno%state->cpu_count].cpu : -1;
+	thrd->slot = state->pin ? (int)(tno%state->cpu_count) : -1;
+	thrd->should_exit = 0;
+	thrd->last_error_ns = 0;
+	thrd->cpu_usage = 0;
+	sensors_clear(&thrd->sample);
+	thrd->left = 0;
+	thrd->burst_start = 0;
+	thrd->window_checks = 0;
+	thrd->window_rate = -1;
+	thrd->start_ns = monotonic_ns();
+	thrd->epoch = state->epoch;
+	thrd->sched = state->sched;
+	thrd->stats = state->stats && tno < state->stats->capacity ? &state->stats->threads[tno] : NULL;
+	thrd->worker = cpucheck_worker_new(state->table, random(), on_error, thrd);
+	if (!thrd->worker)
+		goto err_thrd;
+	if (state->walk->prefetch)
+		cpucheck_worker_set_prefetch(thrd->worker, state->walk->prefetch);
+	cpucheck_worker_set_repeat(thrd->worker, state->repeat);
+	publish_stats(thrd);
 
-	state->table = malloc(args->table_size*args->checker->table_elt_size);
-	if (!state->table) {
-		fprintf(stderr, "Could not allocate table\n");
-		goto err_conf;
+	if (pthread_create(&thrd->thread, NULL, thread_func, thrd)) {
+		fprintf(stderr, "Issue when spawning thread\n");
+		goto err_worker;
+	}
+	if (thrd->cpu != -1 && pin_thread(thrd->thread, thrd->cpu)) {
+		pthread_mutex_lock(&state->output);
+		fprintf(stderr, "Could not pin thread %u on cpu %d\n", tno, thrd->cpu);
+		pthread_mutex_unlock(&state->output);
+		thrd->cpu = -1;
+		thrd->slot = -1;
 	}
-	state->table_size = args->table_size;
 
-	if (args->checker->init(state->checker_conf, state->table, args->table_size)) {
-		fprintf(stderr, "Error while initialising table\n");
-		goto err_table;
+	state->threads[tno] = thrd;
+	state->nb_threads++;
+	if (state->stats)
+		__atomic_store_n(&state->stats->nb_threads, min(state->nb_threads, state->stats->capacity), __ATOMIC_RELEASE);
+
+	return 0;
+
+err_worker:
+	cpucheck_worker_delete(thrd->worker);
+err_thrd:
+	free(thrd);
+	return -1;
+}
+
+/* Accounts for the counters of a joined thread and frees it */
+static void retire_thread(struct state * const state, struct thread_state * const thrd)
+{
+	state->retired_inconsistencies += min(ULONG_MAX-state->retired_inconsistencies,
+			cpucheck_worker_inconsistencies(thrd->worker));
+	state->retired_checks += min(ULONG_MAX-state->retired_checks, cpucheck_worker_checks(thrd->worker));
+	state->retired_usage += thrd->cpu_usage;
+	state->retired_threads++;
+	if (thrd->slot != -1 && state->cpus[thrd->slot].core_type != CORE_TYPE_UNKNOWN) {
+		const int type = state->cpus[thrd->slot].core_type;
+
+		state->type_checks[type] += min(ULONG_MAX-state->type_checks[type], cpucheck_worker_checks(thrd->worker));
+		state->type_seconds[type] += (monotonic_ns() - thrd->start_ns) / 1e9;
+		state->type_threads[type]++;
 	}
+	cpucheck_worker_delete(thrd->worker);
+	free(thrd);
+}
 
-	state->threads = malloc(sizeof(*state->threads) * args->nb_threads);
-	if (!state->threads) {
-		fprintf(stderr, "Could not allocate threads states\n");
-		goto err_table;
+/* Joins the last thread, must be called with ctl held and the thread
+ * exiting */
+static void remove_thread(struct state * const state)
+{
+	struct thread_state * const thrd = state->threads[state->nb_threads-1];
+
+	pthread_mutex_unlock(&state->ctl);
+	pthread_join(thrd->thread, NULL);
+	pthread_mutex_lock(&state->ctl);
+
+	state->nb_threads--;
+	state->parked--;
+	chunk_sched_set_weight(state->sched, state->nb_threads, 1);
+	if (state->stats)
+		__atomic_store_n(&state->stats->nb_threads, min(state->nb_threads, state->stats->capacity), __ATOMIC_RELEASE);
+	retire_thread(state, thrd);
+}
+
+static int set_thread_count(struct state * const state, const unsigned int nb_threads)
+{
+	const int shrinking = nb_threads < state->nb_threads;
+	int r = 0;
+
+	if (shrinking)
+		pause_workers(state);
+
+	pthread_mutex_lock(&state->ctl);
+	while (!r && state->nb_threads < nb_threads)
+		r = add_thread(state);
+	while (state->nb_threads > nb_threads) {
+		state->threads[state->nb_threads-1]->should_exit = 1;
+		pthread_cond_broadcast(&state->ctl_cond);
+		remove_thread(state);
 	}
+	pthread_mutex_unlock(&state->ctl);
 
-	for (tno=0 ; tno<args->nb_threads ; tno++) {
-		state->threads[tno].state = state;
-		state->threads[tno].start_idx = random()%args->table_size;
-		state->threads[tno].comp = malloc(args->checker->comp_elt_size);
-		if (!state->threads[tno].comp) {
-			unsigned int tno2;
+	if (shrinking)
+		resume_workers(state);
 
-			for (tno2=0 ; tno2<tno ; tno++)
-				free(state->threads[tno2].comp);
-			goto err_threads;
-		}
-		state->threads[tno].inconsistencies = 0;
-		state->threads[tno].checks = 0;
+	return r;
+}
+
+static struct cpucheck_table * new_table(struct walk const * const walk,
+		struct cpucheck_checker const * const checker, const size_t table_size)
+{
+	struct cpucheck_table *table;
+	size_t stride = walk->stride;
+
+	table = cpucheck_table_new(checker, table_size);
+	if (!table)
+		return NULL;
+
+	if (walk->order == CPUCHECK_WALK_STRIDE && walk->page)
+		stride = walk->page/checker->table_elt_size + !!(walk->page%checker->table_elt_size);
+	if (cpucheck_table_set_walk(table, walk->order, stride)) {
+		cpucheck_table_delete(table);
+		return NULL;
 	}
 
-	if (pthread_mutex_init(&state->output, NULL)) {
-		fprintf(stderr, "Could not allocate output mutex\n");
-		goto err_threads;
+	return table;
+}
+
+/* Coverage restarts with each table */
+static struct chunk_sched * new_sched(struct state const * const state, const size_t table_size)
+{
+	return chunk_sched_new(table_size, WORKER_BATCH, max(state->nb_threads, get_core_count()),
+			state->cpus ? state->cpu_count : 1, state->coverage);
+}
+
+/* Number of cpus that can be covered at once */
+static unsigned int coverable_cpus(struct state const * const state)
+{
+	return state->cpus ? min(state->nb_threads, state->cpu_count) : 1;
+}
+
+/* The new table is built while workers keep checking the current one */
+static int switch_table(struct state * const state, struct cpucheck_checker const * const checker, const size_t table_size)
+{
+	struct cpucheck_table *table, *old;
+	struct chunk_sched *sched, *old_sched;
+	unsigned int tno;
+
+	table = new_table(state->walk, checker, table_size);
+	if (!table)
+		return -1;
+	sched = new_sched(state, table_size);
+	if (!sched) {
+		cpucheck_table_delete(table);
+		return -1;
 	}
 
+	pause_workers(state);
+	pthread_mutex_lock(&state->ctl);
+
+	old = state->table;
+	for (tno=0 ; tno<state->nb_threads ; tno++)
+		if (cpucheck_worker_set_table(state->threads[tno]->worker, table))
+			break;
+	if (tno < state->nb_threads) {
+		/* Cannot fail, comps are big enough for the old table */
+		while (tno--)
+			cpucheck_worker_set_table(state->threads[tno]->worker, old);
+		pthread_mutex_unlock(&state->ctl);
+		resume_workers(state);
+		chunk_sched_delete(sched);
+		cpucheck_table_delete(table);
+		return -1;
+	}
+
+	/* Chunks in progress belong to the old scheduler */
+	chunk_sched_copy_weights(sched, state->sched);
+	state->table = table;
+	old_sched = state->sched;
+	state->sched = sched;
+	__atomic_add_fetch(&state->epoch, 1, __ATOMIC_RELEASE);
+	for (tno=0 ; tno<state->nb_threads ; tno++) {
+		state->threads[tno]->left = 0;
+		state->threads[tno]->sched = sched;
+		state->threads[tno]->epoch = state->epoch;
+	}
+	if (state->stats) {
+		state->stats->table_size = table_size;
+		strncpy(state->stats->checker, checker->name, sizeof(state->stats->checker)-1);
+	}
+
+	pthread_mutex_unlock(&state->ctl);
+	resume_workers(state);
+
+	chunk_sched_delete(old_sched);
+	cpucheck_table_delete(old);
+
 	return 0;
+}
 
-err_threads:
-	free(state->threads);
-err_table:
-	if (args->checker->delete)
-		args->checker->delete(state->checker_conf, state->table, args->table_size);
-	free(state->table);
-err_conf:
-	free(state->checker_conf);
-	return -1;
+/* Detaches the stale table once every worker left it, must be called with
+ * ctl held. Returns non-zero if it is still in use. */
+static int reclaim_stale(struct state * const state, struct cpucheck_table ** const table, struct chunk_sched ** const sched)
+{
+	const unsigned long int epoch = __atomic_load_n(&state->epoch, __ATOMIC_RELAXED);
+	unsigned int tno;
+
+	*table = NULL;
+	*sched = NULL;
+	if (!state->stale_table)
+		return 0;
+
+	for (tno=0 ; tno<state->nb_threads ; tno++)
+		if (__atomic_load_n(&state->threads[tno]->epoch, __ATOMIC_ACQUIRE) != epoch)
+			return -1;
+
+	*table = state->stale_table;
+	*sched = state->stale_sched;
+	state->stale_table = NULL;
+	state->stale_sched = NULL;
+
+	return 0;
 }
 
-static int run(struct args const * const args)
+/* Builds tables with fresh inputs at low priority while workers check the
+ * current one, and publishes each once every chunk of the current one was
+ * handed out. Tables switched by control commands discard the one being
+ * built. */
+static void * regen_func(void *arg)
+{
+	struct state * const state = arg;
+	struct timespec tick = { .tv_sec = 0, .tv_nsec = 10000000 };
+	struct cpucheck_table *table = NULL, *stale_table;
+	struct chunk_sched *sched = NULL, *stale_sched;
+	struct cpucheck_checker const *checker = NULL;
+	unsigned long int epoch = 0;
+	size_t table_size = 0;
+	int build;
+
+	/* Not SCHED_IDLE, which would starve behind checker threads using every cpu */
+	if (set_thread_priority(0, 19)) {
+		pthread_mutex_lock(&state->output);
+		fprintf(stderr, "Table regeneration keeps its default priority\n");
+		pthread_mutex_unlock(&state->output);
+	}
+
+	while (!state->should_exit) {
+		build = 0;
+		pthread_mutex_lock(&state->ctl);
+		if (!reclaim_stale(state, &stale_table, &stale_sched)) {
+			if (table && epoch != state->epoch) {
+				chunk_sched_delete(sched);
+				cpucheck_table_delete(table);
+				table = NULL;
+			}
+			if (table && chunk_sched_pass(state->sched) >= 2) {
+				chunk_sched_copy_weights(sched, state->sched);
+				state->stale_table = state->table;
+				state->stale_sched = state->sched;
+				__atomic_store_n(&state->table, table, __ATOMIC_RELAXED);
+				__atomic_store_n(&state->sched, sched, __ATOMIC_RELAXED);
+				__atomic_add_fetch(&state->epoch, 1, __ATOMIC_RELEASE);
+				state->regenerations++;
+				table = NULL;
+			} else if (!table) {
+				checker = cpucheck_table_checker(state->table);
+				table_size = cpucheck_table_size(state->table);
+				epoch = state->epoch;
+				sched = new_sched(state, table_size);
+				build = 1;
+			}
+		}
+		pthread_mutex_unlock(&state->ctl);
+
+		if (stale_table) {
+			chunk_sched_delete(stale_sched);
+			cpucheck_table_delete(stale_table);
+		}
+		if (build && (!sched || !(table = new_table(state->walk, checker, table_size)))) {
+			if (sched)
+				chunk_sched_delete(sched);
+			pthread_mutex_lock(&state->output);
+			fprintf(stderr, "Table regeneration stopped\n");
+			pthread_mutex_unlock(&state->output);
+			break;
+		}
+
+		nanosleep(&tick, NULL);
+	}
+
+	if (table) {
+		chunk_sched_delete(sched);
+		cpucheck_table_delete(table);
+	}
+
+	return NULL;
+}
+
+static void print_kernels(FILE *out, struct cpucheck_table const * const table)
+{
+	char const * const kernel = cpucheck_table_kernel(table);
+
+	if (kernel)
+		fprintf(out, "kernels: %s, checksums with %s\n", kernel, cpucheck_checksum_kernel());
+	else
+		fprintf(out, "kernels: checksums with %s\n", cpucheck_checksum_kernel());
+}
+
+static void print_counters(FILE *out, struct state * const state)
 {
-	struct state state = { .checker = args->checker, .should_exit = 0 };
-	size_t tno;
 	unsigned long int inc_cnt, check_cnt;
-	struct sigaction sa;
-	int r;
+	unsigned int tno;
+
+	pthread_mutex_lock(&state->ctl);
+	inc_cnt = state->retired_inconsistencies;
+	check_cnt = state->retired_checks;
+	for (tno=0 ; tno<state->nb_threads ; tno++) {
+		struct thread_state const * const thrd = state->threads[tno];
+		const unsigned long int inc = cpucheck_worker_inconsistencies(thrd->worker);
+		const unsigned long int checks = cpucheck_worker_checks(thrd->worker);
+
+		if (thrd->slot != -1 && state->cpus[thrd->slot].core_type != CORE_TYPE_UNKNOWN)
+			fprintf(out, "thread %u: cpu %d (%s core), %lu inconsistencies over %lu tests\n", tno, thrd->cpu,
+					topology_core_type_name(state->cpus[thrd->slot].core_type), inc, checks);
+		else
+			fprintf(out, "thread %u: cpu %d, %lu inconsistencies over %lu tests\n", tno, thrd->cpu, inc, checks);
+		inc_cnt += min(ULONG_MAX-inc_cnt, inc);
+		check_cnt += min(ULONG_MAX-check_cnt, checks);
+	}
+	fprintf(out, "checker %s, table size %zu, %u threads%s\n", cpucheck_table_checker(state->table)->name,
+			cpucheck_table_size(state->table), state->nb_threads, state->user_paused ? ", paused" : "");
+	print_kernels(out, state->table);
+	fprintf(out, "total: %lu inconsistencies over %lu tests\n", inc_cnt, check_cnt);
+	fprintf(out, "coverage: %u times on %u cpus\n",
+			chunk_sched_coverage(state->sched, coverable_cpus(state)), coverable_cpus(state));
+	pthread_mutex_unlock(&state->ctl);
+}
+
+static void control_command(void * const ctx, char const * const line, FILE *reply)
+{
+	struct state * const state = ctx;
+	struct cpucheck_checker const *checker;
+	char cmd[16], arg[64], *tmpcp;
+	unsigned long int tmpul = 0;
+	int n;
+
+	n = sscanf(line, "%15s %63s", cmd, arg);
+	if (n < 1)
+		return;
+	if (n == 2) {
+		errno = 0;
+		tmpul = strtoul(arg, &tmpcp, 0);
+		if (errno || *tmpcp)
+			tmpul = 0;
+	}
+
+	if (!strcmp(cmd, "checker") && n == 2) {
+		checker = cpucheck_find_checker(arg);
+		if (!checker) {
+			fprintf(reply, "error: checker %s not found\n", arg);
+			return;
+		}
+		if (state->compact && checker->compact)
+			checker = checker->compact;
+		if (switch_table(state, checker, cpucheck_table_size(state->table))) {
+			fprintf(reply, "error: could not switch checker\n");
+			return;
+		}
+	} else if (!strcmp(cmd, "regen") && (n == 1 || tmpul)) {
+		if (switch_table(state, cpucheck_table_checker(state->table), n == 2 ? tmpul : cpucheck_table_size(state->table))) {
+			fprintf(reply, "error: could not regenerate table\n");
+			return;
+		}
+	} else if (!strcmp(cmd, "threads") && n == 2 && tmpul && tmpul <= UINT_MAX) {
+		if (set_thread_count(state, tmpul)) {
+			fprintf(reply, "error: could only start %u threads\n", state->nb_threads);
+			return;
+		}
+	} else if (!strcmp(cmd, "pause") && n == 1) {
+		if (!state->user_paused)
+			pause_workers(state);
+		state->user_paused = 1;
+	} else if (!strcmp(cmd, "resume") && n == 1) {
+		if (state->user_paused)
+			resume_workers(state);
+		state->user_paused = 0;
+	} else if (!strcmp(cmd, "stats") && n == 1) {
+		print_counters(reply, state);
+	} else if (!strcmp(cmd, "stop") && n == 1) {
+		state->should_exit = 1;
+		pthread_mutex_lock(&state->ctl);
+		pthread_cond_broadcast(&state->ctl_cond);
+		pthread_mutex_unlock(&state->ctl);
+	} else {
+		fprintf(reply, "%scommands: checker <name>, regen [tableSize], threads <nbThreads>,"
+				" pause, resume, stats, stop\n", strcmp(cmd, "help") ? "error: unknown command, " : "");
+		return;
+	}
+
+	fprintf(reply, "ok\n");
+}
+
+/* Re-verifies table slices from where the previous tick stopped, for at most
+ * SCRUB_BUDGET_NS and one pass. Holding ctl keeps the table alive. */
+static void scrub(struct state * const state)
+{
+	size_t slices, slice;
+	uint64_t start;
+
+	pthread_mutex_lock(&state->ctl);
+
+	slices = cpucheck_table_slices(state->table);
+	if (state->scrub_table != state->table) {
+		free(state->scrub_reported);
+		state->scrub_reported = calloc(slices, sizeof(*state->scrub_reported));
+		state->scrub_table = state->table;
+		state->scrub_cursor = 0;
+	}
+
+	if (state->scrub_reported) {
+		start = monotonic_ns();
+		do {
+			slice = state->scrub_cursor;
+			state->scrub_cursor = (slice+1) % slices;
+			if (!state->scrub_reported[slice] && cpucheck_table_verify_slice(state->table, slice)) {
+				state->scrub_reported[slice] = 1;
+				state->corrupted_slices++;
+				pthread_mutex_lock(&state->output);
+				fprintf(stderr, "Table corrupted: slice %zu of %zu does not match its checksum anymore\n",
+						slice, slices);
+				pthread_mutex_unlock(&state->output);
+			}
+		} while (state->scrub_cursor && monotonic_ns()-start < SCRUB_BUDGET_NS);
+	}
+
+	pthread_mutex_unlock(&state->ctl);
+}
+
+/* Compares the check rate of each cpu to the ones of its peers of the same
+ * core type over the last window */
+static void compare_rates(struct state * const state, struct cpucheck_checker const * const checker, const int core_type)
+{
+	double median, ratio;
+	unsigned int slot, n, i;
+
+	for (slot=0, n=0 ; slot<state->cpu_count ; slot++)
+		if (state->rates[slot] >= 0 && state->cpus[slot].core_type == core_type)
+			state->rated_slots[n++] = slot;
+	if (n < STRAGGLER_MIN_PEERS)
+		return;
+	for (i=0 ; i<n ; i++)
+		state->peer_rates[i] = state->rates[state->rated_slots[i]];
+
+	median = outliers_scores(state->peer_rates, n, state->scores);
+	if (median <= 0)
+		return;
+
+	for (i=0 ; i<n ; i++) {
+		struct straggler * const s = &state->stragglers[state->rated_slots[i]];
+
+		s->windows++;
+		ratio = state->peer_rates[i] / median;
+		if (fabs(state->scores[i]) <= OUTLIERS_THRESHOLD || fabs(ratio - 1) < STRAGGLER_MIN_DEVIATION)
+			continue;
+
+		s->flagged++;
+		if (fabs(ratio - 1) > fabs(s->worst - 1))
+			s->worst = ratio;
+		pthread_mutex_lock(&state->output);
+		fprintf(stderr, "Cpu %d checked %s at %.1f%% of the median rate of its %u %s%speers (%.0f/s, modified z-score %.1f)\n",
+				state->cpus[state->rated_slots[i]].cpu, checker->name, 100*ratio, n-1,
+				core_type == CORE_TYPE_UNKNOWN ? "" : topology_core_type_name(core_type),
+				core_type == CORE_TYPE_UNKNOWN ? "" : " core ", state->peer_rates[i], state->scores[i]);
+		pthread_mutex_unlock(&state->output);
+	}
+}
+
+/* Compares the check rates of cpus over the last window, and weights the
+ * chunk queue of each thread by its rate, must be called with ctl held.
+ * Windows restart whenever threads or the checker change, so that every rate
+ * covers the whole window. */
+static void watch_rates(struct state * const state)
+{
+	struct cpucheck_checker const * const checker = cpucheck_table_checker(state->table);
+	const uint64_t now = monotonic_ns();
+	unsigned int tno, slot, rated = 0;
+	double mean = 0;
+	int type;
+
+	if (now - state->window_start < state->window_ns)
+		return;
+
+	if (state->nb_threads != state->window_threads || checker != state->window_checker || state->user_paused) {
+		for (tno=0 ; tno<state->nb_threads ; tno++)
+			state->threads[tno]->window_checks = cpucheck_worker_checks(state->threads[tno]->worker);
+		state->window_threads = state->nb_threads;
+		state->window_checker = checker;
+		state->window_start = now;
+		return;
+	}
 
-	if (init_state(&state, args))
+	for (slot=0 ; slot<state->cpu_count ; slot++)
+		state->rates[slot] = -1;
+	for (tno=0 ; tno<state->nb_threads ; tno++) {
+		struct thread_state * const thrd = state->threads[tno];
+		const unsigned long int checks = cpucheck_worker_checks(thrd->worker);
+
+		thrd->window_rate = -1;
+		if (thrd->slot != -1) {
+			thrd->window_rate = (checks - thrd->window_checks) * 1e9 / (now - state->window_start);
+			state->rates[thrd->slot] = max(state->rates[thrd->slot], 0) + thrd->window_rate;
+			mean += thrd->window_rate;
+			rated++;
+		}
+		thrd->window_checks = checks;
+	}
+	state->window_start = now;
+
+	/* Weights are relative to the mean rate, queues of unpinned threads
+	 * and spare ones keep the default of 1 */
+	if (rated && mean > 0) {
+		mean /= rated;
+		for (tno=0 ; tno<state->nb_threads ; tno++)
+			if (state->threads[tno]->window_rate > 0)
+				chunk_sched_set_weight(state->sched, tno, state->threads[tno]->window_rate / mean);
+	}
+
+	for (type=CORE_TYPE_UNKNOWN ; type<CORE_TYPE_COUNT ; type++)
+		compare_rates(state, checker, type);
+}
+
+static int cmp_u64(void const * const a, void const * const b)
+{
+	return *(uint64_t const*)a < *(uint64_t const*)b ? -1 : *(uint64_t const*)a > *(uint64_t const*)b;
+}
+
+/* Flips one bit of an expected result at a time, waits for a checker thread
+ * to report it, and restores it. Bytes are flipped atomically, workers only
+ * ever see the original or the flipped value. */
+static int selftest(struct state * const state, FILE *out)
+{
+	struct cpucheck_checker const * const checker = cpucheck_table_checker(state->table);
+	const size_t table_size = cpucheck_table_size(state->table);
+	struct timespec poll = { .tv_sec = 0, .tv_nsec = 100000 };
+	struct timespec gap;
+	uint64_t *latencies, start, detected;
+	unsigned int nb_fields, found = 0, missed = 0, n, i, bucket;
+
+	for (nb_fields=0 ; checker->expected[nb_fields].name ; nb_fields++) ;
+
+	latencies = malloc(sizeof(*latencies)*SELFTEST_INJECTIONS);
+	if (!latencies) {
+		fprintf(stderr, "Could not allocate latencies\n");
 		return -1;
+	}
 
-	should_stop = &state.should_exit;
-	memset(&sa, 0, sizeof(sa));
-	sa.sa_handler = shouldstop_sig_handler;
-	sigaction(SIGINT, &sa, NULL);
+	for (n=0 ; n<SELFTEST_INJECTIONS && !state->should_exit ; n++) {
+		struct cpucheck_field const * const field = &checker->expected[random()%nb_fields];
+		void * const elt = cpucheck_table_element(state->table, cpucheck_ulirandom()%table_size);
+		uint8_t * const byte = (uint8_t*)elt + field->offset + random()%field->size;
+		const uint8_t mask = 1 << random()%8;
+
+		/* Lands injections anywhere in a pass, and lets late reports
+		 * of the previous one drain */
+		gap.tv_sec = 0;
+		gap.tv_nsec = 1000000 + random()%10000000;
+		nanosleep(&gap, NULL);
+
+		__atomic_store_n(&state->detected_ns, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&state->injected, elt, __ATOMIC_RELEASE);
+		start = monotonic_ns();
+		__atomic_fetch_xor(byte, mask, __ATOMIC_SEQ_CST);
+
+		while (!(detected = __atomic_load_n(&state->detected_ns, __ATOMIC_ACQUIRE))
+				&& !state->should_exit && monotonic_ns()-start < SELFTEST_TIMEOUT_NS)
+			nanosleep(&poll, NULL);
+
+		__atomic_fetch_xor(byte, mask, __ATOMIC_SEQ_CST);
+
+		if (detected)
+			latencies[found++] = detected - start;
+		else if (!state->should_exit)
+			missed++;
+	}
+
+	fprintf(out, "Self-test of %s with %zu elements and %u threads: %u faults injected, %u missed\n",
+			checker->name, table_size, state->nb_threads, found+missed, missed);
+
+	if (found) {
+		qsort(latencies, found, sizeof(*latencies), cmp_u64);
+		fprintf(out, "Detection latency (us): min %.1f, median %.1f, p90 %.1f, p99 %.1f, max %.1f\n",
+				latencies[0]/1000., latencies[found/2]/1000., latencies[found*9/10]/1000.,
+				latencies[found*99/100]/1000., latencies[found-1]/1000.);
+		fprintf(out, "# upper bound (us),faults\n");
+		for (i=0, bucket=1 ; i<found ; bucket*=2) {
+			for (n=0 ; i<found && latencies[i] <= bucket*1000ULL ; i++, n++) ;
+			if (n)
+				fprintf(out, "%u,%u\n", bucket, n);
+		}
+	}
+
+	free(latencies);
 
-	for (tno=0 ; tno < args->nb_threads ; tno++) {
-		if (pthread_create(&state.threads[tno].thread, NULL, thread_func, &state.threads[tno])) {
-			size_t tnob;
+	return 0;
+}
+
+static int run(struct args const * const args)
+{
+	struct state state = { .should_exit = 0, .pauses = 0, .nb_threads = 0, .parked = 0, .threads = NULL,
+		.user_paused = 0, .retired_inconsistencies = 0, .retired_checks = 0, .stats = NULL, .cpus = NULL,
+		.retired_usage = 0, .retired_threads = 0, .background = args->background, .nice = args->nice,
+		.budget = args->budget, .burst = &args->burst, .walk = &args->walk, .repeat = args->repeat,
+		.pin = args->pin, .compact = args->compact, .coverage = args->coverage, .cpu_slots = NULL,
+		.cpu_slots_size = 0, .injected = NULL, .detected_ns = 0, .injected_reports = 0,
+		.table_corruptions = 0, .scrub_table = NULL, .scrub_reported = NULL, .scrub_cursor = 0, .corrupted_slices = 0,
+		.epoch = 0, .stale_table = NULL, .stale_sched = NULL, .regenerations = 0, .triage = NULL,
+		.signatures = NULL, .reports = args->reports, .window_ns = args->window*1000000000ULL, .window_start = 0,
+		.window_threads = 0, .window_checker = NULL, .stragglers = NULL, .rates = NULL, .peer_rates = NULL,
+		.scores = NULL, .rated_slots = NULL };
+	struct control *control = NULL;
+	struct timespec tick = { .tv_sec = 0, .tv_nsec = 100000000 };
+	pthread_t regen_thread;
+	int regen_started = 0;
+	unsigned long int inc_cnt, check_cnt, untriaged = 0;
+	unsigned int tno;
+	uint64_t start_ns, elapsed_ns, next_summary = 0;
+	int r = -1;
+
+	if (args->mode == MODE_SELFTEST) {
+		if (!args->checker->expected) {
+			fprintf(stderr, "Checker %s does not support fault injection\n", args->checker->name);
+			return -1;
+		}
+		if (args->control_path) {
+			fprintf(stderr, "Control socket is not available in selftest mode\n");
+			return -1;
+		}
+		if (args->regen) {
+			fprintf(stderr, "Table regeneration is not available in selftest mode\n");
+			return -1;
+		}
+	}
+
+	if (topology_get(&state.cpus, &state.cpu_count)) {
+		if (args->pin) {
+			fprintf(stderr, "Could not get cpu list\n");
+			return -1;
+		}
+		state.cpus = NULL;
+	}
+	if (state.cpus) {
+		/* Pinned threads fill physical cores first, performance ones first */
+		if (topology_spread_order(state.cpus, state.cpu_count)) {
+			fprintf(stderr, "Could not order cpus\n");
+			goto err_cpus;
+		}
+		for (tno=0 ; tno<state.cpu_count ; tno++)
+			state.cpu_slots_size = max(state.cpu_slots_size, (unsigned int)state.cpus[tno].cpu + 1);
+		state.cpu_slots = malloc(sizeof(*state.cpu_slots)*state.cpu_slots_size);
+		if (!state.cpu_slots) {
+			fprintf(stderr, "Could not allocate cpu slots\n");
+			goto err_cpus;
+		}
+		for (tno=0 ; tno<state.cpu_slots_size ; tno++)
+			state.cpu_slots[tno] = -1;
+		for (tno=0 ; tno<state.cpu_count ; tno++)
+			state.cpu_slots[state.cpus[tno].cpu] = tno;
+	}
+
+	/* Rates are only comparable between pinned threads, and follow the
+	 * scheduling of sleeps with a budget or bursts */
+	if (args->pin && state.window_ns && args->mode != MODE_SELFTEST && args->budget >= 100 && !args->burst.period) {
+		state.stragglers = calloc(state.cpu_count, sizeof(*state.stragglers));
+		state.rates = malloc(sizeof(*state.rates)*state.cpu_count);
+		state.peer_rates = malloc(sizeof(*state.peer_rates)*state.cpu_count);
+		state.scores = malloc(sizeof(*state.scores)*state.cpu_count);
+		state.rated_slots = malloc(sizeof(*state.rated_slots)*state.cpu_count);
+		if (!state.stragglers || !state.rates || !state.peer_rates || !state.scores || !state.rated_slots) {
+			fprintf(stderr, "Could not allocate straggler detection state\n");
+			goto err_cpus;
+		}
+		for (tno=0 ; tno<state.cpu_count ; tno++)
+			state.stragglers[tno].worst = 1;
+	}
+
+	state.table = new_table(&args->walk, args->checker, args->table_size);
+	if (!state.table)
+		goto err_cpus;
+	print_kernels(stdout, state.table);
+	state.sched = chunk_sched_new(args->table_size, WORKER_BATCH, max(args->nb_threads, get_core_count()),
+			state.cpus ? state.cpu_count : 1, args->coverage);
+	if (!state.sched)
+		goto err_table;
+
+	if (pthread_mutex_init(&state.output, NULL)) {
+		fprintf(stderr, "Could not allocate output mutex\n");
+		goto err_sched;
+	}
+	if (pthread_mutex_init(&state.ctl, NULL) || pthread_cond_init(&state.ctl_cond, NULL)) {
+		fprintf(stderr, "Could not allocate control mutex\n");
+		goto err_output;
+	}
+
+	if (args->stats_name) {
+		state.stats = stats_create(args->stats_name, max(args->nb_threads, get_core_count()),
+				args->table_size, args->checker->name);
+		if (!state.stats)
+			goto err_ctl;
+	}
+
+	state.signatures = signatures_new();
+	if (!state.signatures)
+		goto err_stats;
+
+	if (args->triage) {
+		state.triage = triage_start(state.cpus, state.cpus ? state.cpu_count : 0, args->triage, &state.output);
+		if (!state.triage)
+			goto err_stats;
+	}
+
+	install_stop_handler(&state.should_exit, args->duration);
+
+	start_ns = monotonic_ns();
+	if (set_thread_count(&state, args->nb_threads))
+		goto err_threads;
+
+	if (args->control_path) {
+		control = control_start(args->control_path, control_command, &state);
+		if (!control)
+			goto err_threads;
+	}
+
+	if (args->regen) {
+		if (pthread_create(&regen_thread, NULL, regen_func, &state)) {
+			fprintf(stderr, "Could not spawn table regeneration thread\n");
+			goto err_threads;
+		}
+		regen_started = 1;
+	}
+
+	if (args->mode == MODE_SELFTEST && selftest(&state, stdout))
+		goto err_threads;
+
+	while (!state.should_exit && args->mode != MODE_SELFTEST) {
+		nanosleep(&tick, NULL);
+		scrub(&state);
+		if (!__atomic_load_n(&state.reports, __ATOMIC_RELAXED) && monotonic_ns() >= next_summary) {
 			pthread_mutex_lock(&state.output);
-			fprintf(stderr, "Issue when spawning thread\n");
+			signatures_print(state.signatures, stderr);
 			pthread_mutex_unlock(&state.output);
-			state.should_exit = 1;
-			for (tnob=0 ; tnob < tno ; tnob++) {
-				pthread_join(state.threads[tno].thread, NULL);
-			}
-			r = -1;
-			goto err_mutex;
+			next_summary = monotonic_ns() + SIGNATURES_PERIOD_NS;
+		}
+		if (state.stragglers) {
+			pthread_mutex_lock(&state.ctl);
+			watch_rates(&state);
+			pthread_mutex_unlock(&state.ctl);
+		}
+		if (state.coverage) {
+			pthread_mutex_lock(&state.ctl);
+			if (state.nb_threads && chunk_sched_covered(state.sched) >= coverable_cpus(&state))
+				state.should_exit = 1;
+			pthread_mutex_unlock(&state.ctl);
 		}
 	}
 
-	for (inc_cnt=0, check_cnt=0, tno=0 ; tno<args->nb_threads ; tno++) {
-		pthread_join(state.threads[tno].thread, NULL);
-		inc_cnt += min(ULONG_MAX-inc_cnt, state.threads[tno].inconsistencies);
-		check_cnt += min(ULONG_MAX-check_cnt, state.threads[tno].checks);
+	r = 0;
+
+err_threads:
+	/* Commands look at the state torn down below */
+	if (control)
+		control_stop(control);
+	state.should_exit = 1;
+	pthread_mutex_lock(&state.ctl);
+	pthread_cond_broadcast(&state.ctl_cond);
+	pthread_mutex_unlock(&state.ctl);
+	/* Looks at thread states */
+	if (regen_started)
+		pthread_join(regen_thread, NULL);
+	for (tno=0 ; tno<state.nb_threads ; tno++) {
+		pthread_join(state.threads[tno]->thread, NULL);
+		retire_thread(&state, state.threads[tno]);
+	}
+	free(state.threads);
+	if (state.triage)
+		untriaged = triage_stop(state.triage);
+	if (!r)
+		signatures_print(state.signatures, stderr);
+	if (state.stale_table) {
+		chunk_sched_delete(state.stale_sched);
+		cpucheck_table_delete(state.stale_table);
 	}
+	elapsed_ns = monotonic_ns() - start_ns;
+	inc_cnt = state.retired_inconsistencies - min(state.retired_inconsistencies, state.injected_reports);
+	check_cnt = state.retired_checks;
 
-	fprintf(stdout, "Detected %s%lu inconsistencies over %s%lu tests\n",
-			inc_cnt==ULONG_MAX?"possibly more than ":"", inc_cnt,
-			check_cnt==ULONG_MAX?"possibly more than ":"", check_cnt);
-	r = 0;
+	if (!r)
+		fprintf(stdout, "Detected %s%lu inconsistencies over %s%lu tests\n",
+				inc_cnt==ULONG_MAX?"possibly more than ":"", inc_cnt,
+				check_cnt==ULONG_MAX?"possibly more than ":"", check_cnt);
+	if (!r && (state.table_corruptions || state.corrupted_slices))
+		fprintf(stdout, "Table corruption caused %lu of them, scrubbing found %lu corrupted slices\n",
+				state.table_corruptions, state.corrupted_slices);
+	if (!r && elapsed_ns && args->mode != MODE_SELFTEST)
+		fprintf(stdout, "Ran %.0f tests per second walking the table in %s order, %u per element\n",
+				check_cnt * 1e9 / elapsed_ns, args->walk.name, args->repeat);
+	if (!r && args->regen)
+		fprintf(stdout, "Checked %lu regenerated tables\n", state.regenerations);
+	if (!r && untriaged)
+		fprintf(stdout, "Triage skipped %lu inconsistencies\n", untriaged);
+	if (!r && state.nb_threads)
+		fprintf(stdout, "Every element was checked at least %u times on %u cpus\n",
+				chunk_sched_coverage(state.sched, coverable_cpus(&state)), coverable_cpus(&state));
+	for (tno=0 ; !r && state.stragglers && tno<state.cpu_count ; tno++)
+		if (state.stragglers[tno].flagged)
+			fprintf(stdout, "Cpu %d deviated from its peers in %u of %u windows, at %.1f%% of their median rate at worst\n",
+					state.cpus[tno].cpu, state.stragglers[tno].flagged, state.stragglers[tno].windows,
+					100*state.stragglers[tno].worst);
+	if (!r && !!state.type_threads[CORE_TYPE_PERFORMANCE] + !!state.type_threads[CORE_TYPE_EFFICIENCY] > 1)
+		for (tno=0 ; tno<CORE_TYPE_COUNT ; tno++)
+			fprintf(stdout, "Threads on %s cores ran %.0f tests per second each on average, over %u threads\n",
+					topology_core_type_name(tno), state.type_checks[tno] / state.type_seconds[tno],
+					state.type_threads[tno]);
+	if (!r && state.retired_threads && (args->background || args->nice || args->budget < 100))
+		fprintf(stdout, "Checker threads used %.1f%% of a cpu on average\n",
+				state.retired_usage / state.retired_threads);
 
-err_mutex:
+err_stats:
+	if (state.signatures)
+		signatures_delete(state.signatures);
+	if (state.stats)
+		stats_destroy(state.stats, args->stats_name);
+err_ctl:
+	pthread_cond_destroy(&state.ctl_cond);
+	pthread_mutex_destroy(&state.ctl);
+err_output:
 	pthread_mutex_destroy(&state.output);
+err_sched:
 	should_stop = NULL;
-	for (tno=0 ; tno<args->nb_threads ; tno++)
-		free(state.threads[tno].comp);
-	free(state.threads);
-	if (args->checker->delete)
-		args->checker->delete(state.checker_conf, state.table, args->table_size);
-	free(state.table);
-	free(state.checker_conf);
+	free(state.scrub_reported);
+	chunk_sched_delete(state.sched);
+err_table:
+	cpucheck_table_delete(state.table);
+err_cpus:
+	free(state.rated_slots);
+	free(state.scores);
+	free(state.peer_rates);
+	free(state.rates);
+	free(state.stragglers);
+	free(state.cpu_slots);
+	free(state.cpus);
 
 	return r;
 }
 
+static int run_c2c(struct args const * const args)
+{
+	volatile int stop = 0;
+	struct cpu_topo *cpus;
+	unsigned int cpu_count;
+	long int inc_cnt;
+
+	if (topology_get(&cpus, &cpu_count)) {
+		fprintf(stderr, "Could not get cpu list\n");
+		return -1;
+	}
+
+	install_stop_handler(&stop, 0);
+
+	inc_cnt = c2c_run(stdout, cpus, min(cpu_count, args->nb_threads), C2C_ROUNDTRIPS, &stop);
+	if (inc_cnt >= 0)
+		fprintf(stdout, "Detected %ld inconsistencies over %u cpus\n", inc_cnt, min(cpu_count, args->nb_threads));
+
+	should_stop = NULL;
+	free(cpus);
+
+	return inc_cnt < 0 ? -1 : 0;
+}
+
+static int run_litmus(struct args const * const args)
+{
+	volatile int stop = 0;
+	struct cpu_topo *cpus;
+	unsigned int cpu_count;
+	unsigned long int tests;
+	long int inc_cnt;
+
+	if (topology_get(&cpus, &cpu_count)) {
+		fprintf(stderr, "Could not get cpu list\n");
+		return -1;
+	}
+
+	install_stop_handler(&stop, args->duration);
+
+	inc_cnt = litmus_run(stdout, cpus, min(cpu_count, args->nb_threads), LITMUS_ITERATIONS, &stop, &tests);
+	if (inc_cnt >= 0)
+		fprintf(stdout, "Detected %ld inconsistencies over %lu tests\n", inc_cnt, tests);
+
+	should_stop = NULL;
+	free(cpus);
+
+	return inc_cnt < 0 ? -1 : 0;
+}
+
+static int run_procs(struct args const * const args)
+{
+	volatile int stop = 0;
+	struct cpu_topo *cpus;
+	struct cpucheck_table *table;
+	unsigned int cpu_count;
+	unsigned long int tests;
+	long int inc_cnt;
+
+	if (topology_get(&cpus, &cpu_count)) {
+		fprintf(stderr, "Could not get cpu list\n");
+		return -1;
+	}
+
+	/* Worker processes share its pages until they exit */
+	table = new_table(&args->walk, args->checker, args->table_size);
+	if (!table) {
+		free(cpus);
+		return -1;
+	}
+
+	install_stop_handler(&stop, args->duration);
+
+	inc_cnt = procs_run(stdout, cpus, min(cpu_count, args->nb_threads), table, args->repeat, args->walk.prefetch,
+			args->reports, args->exclude, &stop, &tests);
+	if (inc_cnt >= 0)
+		fprintf(stdout, "Detected %ld inconsistencies over %lu tests\n", inc_cnt, tests);
+
+	should_stop = NULL;
+	cpucheck_table_delete(table);
+	free(cpus);
+
+	return inc_cnt < 0 ? -1 : 0;
+}
+
+static int run_smt(struct args const * const args)
+{
+	volatile int stop = 0;
+	struct cpu_topo *cpus;
+	unsigned int cpu_count;
+	long int inc_cnt;
+
+	if (topology_get(&cpus, &cpu_count)) {
+		fprintf(stderr, "Could not get cpu list\n");
+		return -1;
+	}
+
+	install_stop_handler(&stop, 0);
+
+	inc_cnt = smt_run(stdout, cpus, min(cpu_count, args->nb_threads), args->table_size,
+			args->duration ? max(args->duration/3, 1) : SMT_PHASE_SECONDS, &stop);
+	if (inc_cnt >= 0)
+		fprintf(stdout, "Detected %ld inconsistencies\n", inc_cnt);
+
+	should_stop = NULL;
+	free(cpus);
+
+	return inc_cnt < 0 ? -1 : 0;
+}
+
+static int run_sweep(struct args const * const args)
+{
+	volatile int stop = 0;
+	struct cpu_topo *cpus;
+	struct cpucheck_table *table;
+	unsigned int cpu_count, nb_threads, steps;
+	long int inc_cnt;
+
+	if (topology_get(&cpus, &cpu_count)) {
+		fprintf(stderr, "Could not get cpu list\n");
+		return -1;
+	}
+	nb_threads = min(cpu_count, args->nb_threads);
+	for (steps=1 ; 1U<<(steps-1) < nb_threads ; steps++) ;
+
+	table = new_table(&args->walk, args->checker, args->table_size);
+	if (!table) {
+		free(cpus);
+		return -1;
+	}
+
+	install_stop_handler(&stop, 0);
+
+	inc_cnt = sweep_run(stdout, cpus, nb_threads, table, args->repeat, args->walk.prefetch,
+			args->duration ? max(args->duration/steps, 1) : SWEEP_STEP_SECONDS, &stop);
+	if (inc_cnt >= 0)
+		fprintf(stdout, "Detected %ld inconsistencies\n", inc_cnt);
+
+	should_stop = NULL;
+	cpucheck_table_delete(table);
+	free(cpus);
+
+	return inc_cnt < 0 ? -1 : 0;
+}
+
+/* Checks the element of a reproducer over and over again on one cpu */
+static int run_replay(struct args const * const args)
+{
+	volatile int stop = 0;
+	struct cpucheck_repro *repro;
+	unsigned long int found, inc_cnt = 0, check_cnt = 0;
+	FILE *f;
+
+	f = fopen(args->replay, "r");
+	if (!f) {
+		fprintf(stderr, "Could not open %s: %s\n", args->replay, strerror(errno));
+		return -1;
+	}
+	repro = cpucheck_repro_load(f);
+	fclose(f);
+	if (!repro)
+		return -1;
+
+	if (args->replay_cpu != -1 && pin_thread(pthread_self(), args->replay_cpu)) {
+		fprintf(stderr, "Could not pin on cpu %d\n", args->replay_cpu);
+		cpucheck_repro_delete(repro);
+		return -1;
+	}
+
+	install_stop_handler(&stop, args->duration);
+
+	while (!stop) {
+		found = cpucheck_repro_check(repro, REPLAY_BATCH);
+		if (found && !inc_cnt)
+			cpucheck_repro_report_error(stderr, repro);
+		inc_cnt += min(ULONG_MAX-inc_cnt, found);
+		check_cnt += min(ULONG_MAX-check_cnt, REPLAY_BATCH);
+	}
+
+	fprintf(stdout, "Detected %lu inconsistencies over %lu tests of the %s element on %s %d\n",
+			inc_cnt, check_cnt, cpucheck_repro_checker(repro)->name,
+			args->replay_cpu != -1 ? "cpu" : "unpinned, last on cpu",
+			args->replay_cpu != -1 ? args->replay_cpu : topology_current_cpu());
+
+	should_stop = NULL;
+	cpucheck_repro_delete(repro);
+
+	return 0;
+}
+
 static void print_usage(char const * const progname, struct args const * const args)
 {
 	struct cpucheck_checker const * const * tmpcheck;
+	size_t i;
 
-	fprintf(stderr, "Usage: %s [-c <checker>] [-s <tableSize>] [-t <nbThreads>]\n", progname);
+	fprintf(stderr, "Usage: %s [-a <walk>] [-b] [-B <budget>] [-c <checker>] [-d <duration>] [-D <burst>] [-E <reports>] [-g] [-k <coverage>] [-m <mode>] [-n <nice>] [-p] [-P <prefetch>] [-r <repeat>] [-S <statsName>] [-s <tableSize>] [-t <nbThreads>] [-T <rechecks>] [-U <controlSocket>] [-w <window>] [-x] [-z]\n", progname);
+	fprintf(stderr, "       %s -R|--replay <reproducer> [-C|--cpu <cpu>] [-d <duration>]\n", progname);
 	fprintf(stderr, "\n");
+	fprintf(stderr, "\t-a walk: Sets the order elements are checked in: seq, perm (pseudo-random permutation),\n"
+			"\t\tstride:n (every n-th element), page or hugepage (one element per 4KiB or 2MiB) [%s]\n", args->walk.name);
+	fprintf(stderr, "\t-b: Runs checker threads in the background, under SCHED_IDLE\n");
+	fprintf(stderr, "\t-B budget: Caps the cpu time of each checker thread to budget percent, less when\n"
+			"\t\tother runnable tasks of the host outnumber its cpus [%u]\n", args->budget);
 	fprintf(stderr, "\t-c checker: Sets the checker to use (see below for list) [%s]\n", args->checker->name);
+	fprintf(stderr, "\t-C, --cpu cpu: Replays on cpu, instead of wherever the scheduler runs it\n");
+	fprintf(stderr, "\t-d duration: Stops after duration seconds, 0 runs until interrupted [%u]\n", args->duration);
+	fprintf(stderr, "\t-D period,duty,jitter,idle: Checks in bursts of duty percent of period milliseconds,\n"
+			"\t\tsynchronised between threads and delayed by up to jitter percent of period, idling\n"
+			"\t\tin between with spin, pause or sleep [50,0,sleep]\n");
+	fprintf(stderr, "\t-E reports: Prints full reports of the first reports inconsistencies, then summaries of\n"
+			"\t\ttheir signatures (flipped bits of each output, by checker and cpu) every %u seconds [%lu]\n",
+			(unsigned int)(SIGNATURES_PERIOD_NS/1000000000), args->reports);
+	fprintf(stderr, "\t-g: Keeps building tables with fresh inputs in a low priority thread, switching to each\n"
+			"\t\tonce every element of the current one was handed out\n");
+	fprintf(stderr, "\t-k coverage: Stops once every element was checked at least coverage times (at most %u)\n"
+			"\t\ton as many cpus as there are checker threads\n", CHUNKS_MAX_COVERAGE);
+	fprintf(stderr, "\t-m mode: Sets the run mode (see below for list) [%s]\n", modes[args->mode].name);
+	fprintf(stderr, "\t-n nice: Sets the nice level of checker threads [%d]\n", args->nice);
+	fprintf(stderr, "\t-p: Pins checker threads on allowed cpus, round-robin, physical and performance cores first\n");
+	fprintf(stderr, "\t-P prefetch: Prefetches elements prefetch positions ahead in the walk, 0 disables [%zu]\n",
+			args->walk.prefetch);
+	fprintf(stderr, "\t-r repeat: Checks each element repeat times in a row, more stresses execution units,\n"
+			"\t\tless the memory hierarchy [%u]\n", args->repeat);
+	fprintf(stderr, "\t-R, --replay reproducer: Checks the element saved in reproducer by triage in a tight loop,\n"
+			"\t\tuntil interrupted or for duration seconds\n");
+	fprintf(stderr, "\t-S statsName: Publishes live statistics in a shared memory page, a POSIX shared memory object\n"
+			"\t\tif statsName is \"/name\", a regular file otherwise (see cpucheck-stat)\n");
 	fprintf(stderr, "\t-s tableSize: Sets the table size to tableSize elements [%lu]\n", args->table_size);
-	fprintf(stderr, "\t-t nbThreads: Sets the number of checker threads [%u]\n", args->nb_threads);
+	fprintf(stderr, "\t-t nbThreads: Sets the number of checker threads (cpus for c2c, litmus, procs and smt modes,\n"
+			"\t\thighest count for sweep mode) [%u]\n", args->nb_threads);
+	fprintf(stderr, "\t-T rechecks: Triages each failing element from a side thread, rechecking it rechecks times\n"
+			"\t\ton the cpu it failed on then on every other cpu, and saves a reproducer of it in the\n"
+			"\t\tcurrent directory (not for checkers whose elements refer to memory outside the table)\n");
+	fprintf(stderr, "\t-U controlSocket: Accepts commands on the controlSocket Unix domain socket (send \"help\" for a list)\n");
+	fprintf(stderr, "\t-w window: Compares the check rate of each cpu to its peers every window seconds when\n"
+			"\t\tthreads are pinned, without budget nor bursts, and reports outliers (median absolute\n"
+			"\t\tdeviation), 0 disables [%u]\n", args->window);
+	fprintf(stderr, "\t-x: Leaves out cpus whose worker process was killed in procs mode, instead of restarting it\n");
+	fprintf(stderr, "\t-z: Stores a digest of expected results instead of the results, for checkers marked\n"
+			"\t\twith a *, so that more elements fit in caches\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "Checkers:\n");
-	for (tmpcheck = checkers ; *tmpcheck ; tmpcheck++)
-		fprintf(stderr, "\t%s: %s\n", (*tmpcheck)->name, (*tmpcheck)->description);
+	for (tmpcheck = cpucheck_checkers() ; *tmpcheck ; tmpcheck++)
+		fprintf(stderr, "\t%s%s: %s\n", (*tmpcheck)->name, (*tmpcheck)->compact ? "*" : "", (*tmpcheck)->description);
+	fprintf(stderr, "\n");
+	fprintf(stderr, "Modes:\n");
+	for (i=0 ; i<sizeof(modes)/sizeof(modes[0]) ; i++)
+		fprintf(stderr, "\t%s: %s\n", modes[i].name, modes[i].description);
 }
 
+static int parse_walk(struct walk * const walk, char const * const arg)
+{
+	unsigned long int tmpul;
+	char *tmpcp;
+
+	walk->name = arg;
+	walk->page = 0;
+	if (!strcmp(arg, "seq")) {
+		walk->order = CPUCHECK_WALK_SEQ;
+	} else if (!strcmp(arg, "perm")) {
+		walk->order = CPUCHECK_WALK_PERM;
+	} else if (!strcmp(arg, "page") || !strcmp(arg, "hugepage")) {
+		walk->order = CPUCHECK_WALK_STRIDE;
+		walk->page = strcmp(arg, "page") ? 2*1024*1024 : 4096;
+	} else if (!strncmp(arg, "stride:", 7)) {
+		errno = 0;
+		tmpul = strtoul(arg+7, &tmpcp, 0);
+		if (errno || *tmpcp || !tmpul) {
+			fprintf(stderr, "Stride must be a positive integer\n");
+			return -1;
+		}
+		walk->order = CPUCHECK_WALK_STRIDE;
+		walk->stride = tmpul;
+	} else {
+		fprintf(stderr, "Walk %s not found\n", arg);
+		return -1;
+	}
+
+	return 0;
+}
+
+static struct option const long_options[] = {
+	{ "cpu", required_argument, NULL, 'C' },
+	{ "replay", required_argument, NULL, 'R' },
+	{ NULL, 0, NULL, 0 }
+};
+
 static int parse_args(struct args * const args, int argc, char *argv[])
 {
 	int opt;
 	char const * const progname = argv[0];
 	unsigned long tmpul;
+	long tmpl;
 	char *tmpcp;
-	struct cpucheck_checker const * const * tmpcheck;
+	size_t i;
 
-	while ((opt = getopt(argc, argv, "c:hs:t:")) != -1) {
+	while ((opt = getopt_long(argc, argv, "a:bB:c:C:d:D:E:ghk:m:n:pP:r:R:S:s:t:T:U:w:xz", long_options, NULL)) != -1) {
 		switch(opt) {
+			case 'a':
+				if (parse_walk(&args->walk, optarg))
+					return -1;
+				break;
+			case 'b':
+				args->background = 1;
+				break;
+			case 'B':
+				errno = 0;
+				tmpul = strtoul(optarg, &tmpcp, 0);
+				if (errno || *tmpcp || !tmpul || tmpul > 100) {
+					fprintf(stderr, "Budget must be a percentage between 1 and 100\n");
+					return -1;
+				}
+				args->budget = tmpul;
+				break;
 			case 'c':
-				for (tmpcheck = checkers ; *tmpcheck && strcmp(optarg, (*tmpcheck)->name) ; tmpcheck++) ;
-				if (!tmpcheck) {
+				args->checker = cpucheck_find_checker(optarg);
+				if (!args->checker) {
 					fprintf(stderr, "Checker %s not found\n", optarg);
 					return -1;
 				}
-				args->checker = *tmpcheck;
+				break;
+			case 'C':
+				errno = 0;
+				tmpl = strtol(optarg, &tmpcp, 0);
+				if (errno || *tmpcp || tmpl < 0 || tmpl > INT_MAX) {
+					fprintf(stderr, "Cpu must be a non-negative integer\n");
+					return -1;
+				}
+				args->replay_cpu = tmpl;
+				break;
+			case 'd':
+				errno = 0;
+				tmpul = strtoul(optarg, &tmpcp, 0);
+				if (errno || *tmpcp || tmpul > UINT_MAX) {
+					fprintf(stderr, "Could not parse %s as integer\n", optarg);
+					return -1;
+				}
+				args->duration = tmpul;
+				break;
+			case 'D':
+				if (burst_parse(&args->burst, optarg))
+					return -1;
+				break;
+			case 'E':
+				errno = 0;
+				tmpul = strtoul(optarg, &tmpcp, 0);
+				if (errno || *tmpcp) {
+					fprintf(stderr, "Could not parse %s as integer\n", optarg);
+					return -1;
+				}
+				args->reports = tmpul;
+				break;
+			case 'g':
+				args->regen = 1;
+				break;
+			case 'k':
+				errno = 0;
+				tmpul = strtoul(optarg, &tmpcp, 0);
+				if (errno || *tmpcp || tmpul > CHUNKS_MAX_COVERAGE) {
+					fprintf(stderr, "Coverage must be an integer up to %u\n", CHUNKS_MAX_COVERAGE);
+					return -1;
+				}
+				args->coverage = tmpul;
+				break;
+			case 'm':
+				for (i=0 ; i<sizeof(modes)/sizeof(modes[0]) && strcmp(optarg, modes[i].name) ; i++) ;
+				if (i == sizeof(modes)/sizeof(modes[0])) {
+					fprintf(stderr, "Mode %s not found\n", optarg);
+					return -1;
+				}
+				args->mode = i;
+				break;
+			case 'n':
+				errno = 0;
+				tmpl = strtol(optarg, &tmpcp, 0);
+				if (errno || *tmpcp || tmpl < -20 || tmpl > 19) {
+					fprintf(stderr, "Nice level must be between -20 and 19\n");
+					return -1;
+				}
+				args->nice = tmpl;
+				break;
+			case 'p':
+				args->pin = 1;
+				break;
+			case 'P':
+				errno = 0;
+				tmpul = strtoul(optarg, &tmpcp, 0);
+				if (errno || *tmpcp) {
+					fprintf(stderr, "Could not parse %s as integer\n", optarg);
+					return -1;
+				}
+				args->walk.prefetch = tmpul;
+				break;
+			case 'r':
+				errno = 0;
+				tmpul = strtoul(optarg, &tmpcp, 0);
+				if (errno || *tmpcp || !tmpul || tmpul > UINT_MAX) {
+					fprintf(stderr, "Repeat must be a positive integer\n");
+					return -1;
+				}
+				args->repeat = tmpul;
+				break;
+			case 'R':
+				args->replay = optarg;
 				break;
 			case 'h':
 			case '?':
 			case ':':
 				print_usage(progname, args);
 				return -1;
+			case 'S':
+				args->stats_name = optarg;
+				break;
 			case 's':
 				errno = 0;
 				tmpul = strtoul(optarg, &tmpcp, 0);
@@ -381,12 +1839,52 @@ static int parse_args(struct args * const args, int argc, char *argv[])
 				}
 				args->nb_threads = tmpul;
 				break;
+			case 'T':
+				errno = 0;
+				tmpul = strtoul(optarg, &tmpcp, 0);
+				if (errno || *tmpcp || !tmpul) {
+					fprintf(stderr, "Rechecks must be a positive integer\n");
+					return -1;
+				}
+				args->triage = tmpul;
+				break;
+			case 'U':
+				args->control_path = optarg;
+				break;
+			case 'w':
+				errno = 0;
+				tmpul = strtoul(optarg, &tmpcp, 0);
+				if (errno || *tmpcp || tmpul > UINT_MAX/1000) {
+					fprintf(stderr, "Could not parse %s as a window in seconds\n", optarg);
+					return -1;
+				}
+				args->window = tmpul;
+				break;
+			case 'x':
+				args->exclude = 1;
+				break;
+			case 'z':
+				args->compact = 1;
+				break;
 			default:
 				fprintf(stderr, "Looks like '%c' is unhandled\n", opt);
 				return -1;
 		}
 	}
 
+	if (args->replay_cpu != -1 && !args->replay) {
+		fprintf(stderr, "A cpu can only be given to replay a reproducer\n");
+		return -1;
+	}
+
+	if (args->compact) {
+		if (!args->checker->compact) {
+			fprintf(stderr, "Checker %s has no compact variant\n", args->checker->name);
+			return -1;
+		}
+		args->checker = args->checker->compact;
+	}
+
 	return 0;
 }
 
@@ -401,8 +1899,36 @@ int main(int argc, char *argv[])
 
 	srandom(time(NULL));
 
-	if (run(&args))
-		return EXIT_FAILURE;
+	if (args.replay)
+		return run_replay(&args) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+	switch (args.mode) {
+		case MODE_CHECK:
+		case MODE_SELFTEST:
+			if (run(&args))
+				return EXIT_FAILURE;
+			break;
+		case MODE_C2C:
+			if (run_c2c(&args))
+				return EXIT_FAILURE;
+			break;
+		case MODE_LITMUS:
+			if (run_litmus(&args))
+				return EXIT_FAILURE;
+			break;
+		case MODE_PROCS:
+			if (run_procs(&args))
+				return EXIT_FAILURE;
+			break;
+		case MODE_SMT:
+			if (run_smt(&args))
+				return EXIT_FAILURE;
+			break;
+		case MODE_SWEEP:
+			if (run_sweep(&args))
+				return EXIT_FAILURE;
+			break;
+	}
 
 	return EXIT_SUCCESS;
 }
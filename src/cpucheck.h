@@ -18,8 +18,37 @@
 #define CPUCHECK_H
 
 #include <stdio.h>
+#include <stddef.h>
 #include <stdint.h>
 
+/* Part of a table element holding an expected result, flipping any of its
+ * bits makes check_item() fail. Lists end with a NULL name. */
+struct cpucheck_field {
+	char const * const name;
+	const size_t offset;
+	const size_t size;
+};
+
+#define CPUCHECK_FIELD(type, member) { #member, offsetof(type, member), sizeof(((type*)0)->member) }
+
+/* Result of check_item(), expected at offset in table elements and got at
+ * comp_offset in comps. Several outputs may share an expected result. Lists
+ * end with a NULL name. */
+struct cpucheck_output {
+	char const * const name;
+	const size_t offset;
+	const size_t comp_offset;
+	const size_t size;
+	/* Returns non-zero if check_item() computes the output on this cpu,
+	 * NULL if always */
+	int (* const computed)(void const * const config);
+};
+
+#define CPUCHECK_OUTPUT(type, member, comp_type, comp_member) \
+	CPUCHECK_OUTPUT_IF(type, member, comp_type, comp_member, NULL)
+#define CPUCHECK_OUTPUT_IF(type, member, comp_type, comp_member, arg_computed) \
+	{ #comp_member, offsetof(type, member), offsetof(comp_type, comp_member), sizeof(((type*)0)->member), arg_computed }
+
 struct cpucheck_checker {
 	char const * const name;
 	char const * const description;
@@ -30,9 +59,31 @@ struct cpucheck_checker {
 	int (*check_item)(void * const comp, void const * const config, void const * const table_element);
 	void (*report_error)(FILE *out, void const * const config, void const * const table_element, void const * const comp);
 	void (*delete)(void * const config, void * const table, const size_t table_size);
+	/* May be NULL */
+	struct cpucheck_field const * const expected;
+	/* Variant of the checker whose elements hold a digest of the expected
+	 * results instead of the results (see cpucheck_digest()), may be NULL */
+	struct cpucheck_checker const * const compact;
+	/* May be NULL */
+	struct cpucheck_output const * const outputs;
+	/* Names the instructions check_item() was set up to use on this cpu,
+	 * may be NULL for checkers with a single path */
+	char const * (*kernel)(void const * const config);
 };
 
 #define CPUCHECK_CHECKER(arg_name, arg_description, arg_config_size, arg_table_elt_size, arg_comp_elt_size, arg_init, arg_check_item, arg_report_error, arg_delete) \
+	CPUCHECK_CHECKER_EXPECTED(arg_name, arg_description, arg_config_size, arg_table_elt_size, arg_comp_elt_size, arg_init, arg_check_item, arg_report_error, arg_delete, NULL)
+
+#define CPUCHECK_CHECKER_EXPECTED(arg_name, arg_description, arg_config_size, arg_table_elt_size, arg_comp_elt_size, arg_init, arg_check_item, arg_report_error, arg_delete, arg_expected) \
+	CPUCHECK_CHECKER_COMPACT(arg_name, arg_description, arg_config_size, arg_table_elt_size, arg_comp_elt_size, arg_init, arg_check_item, arg_report_error, arg_delete, arg_expected, NULL)
+
+#define CPUCHECK_CHECKER_COMPACT(arg_name, arg_description, arg_config_size, arg_table_elt_size, arg_comp_elt_size, arg_init, arg_check_item, arg_report_error, arg_delete, arg_expected, arg_compact) \
+	CPUCHECK_CHECKER_OUTPUTS(arg_name, arg_description, arg_config_size, arg_table_elt_size, arg_comp_elt_size, arg_init, arg_check_item, arg_report_error, arg_delete, arg_expected, arg_compact, NULL)
+
+#define CPUCHECK_CHECKER_OUTPUTS(arg_name, arg_description, arg_config_size, arg_table_elt_size, arg_comp_elt_size, arg_init, arg_check_item, arg_report_error, arg_delete, arg_expected, arg_compact, arg_outputs) \
+	CPUCHECK_CHECKER_KERNEL(arg_name, arg_description, arg_config_size, arg_table_elt_size, arg_comp_elt_size, arg_init, arg_check_item, arg_report_error, arg_delete, arg_expected, arg_compact, arg_outputs, NULL)
+
+#define CPUCHECK_CHECKER_KERNEL(arg_name, arg_description, arg_config_size, arg_table_elt_size, arg_comp_elt_size, arg_init, arg_check_item, arg_report_error, arg_delete, arg_expected, arg_compact, arg_outputs, arg_kernel) \
 	struct cpucheck_checker cpucheck_checker_##arg_name = { \
 		.name = #arg_name, \
 		.description = arg_description, \
@@ -43,11 +94,22 @@ struct cpucheck_checker {
 		.check_item = arg_check_item, \
 		.report_error = arg_report_error, \
 		.delete = arg_delete, \
+		.expected = arg_expected, \
+		.compact = arg_compact, \
+		.outputs = arg_outputs, \
+		.kernel = arg_kernel, \
 	};
 
-unsigned long int ulirandom(void);
-uint64_t u64random(void);
+/* Folds v into digest h. Each step is a bijection of h and of v, so that a
+ * single wrong value always yields a wrong digest, and costs two cycles. */
+static inline uint64_t cpucheck_digest(const uint64_t h, const uint64_t v)
+{
+	return (h << 5 | h >> 59) ^ v;
+}
+
+unsigned long int cpucheck_ulirandom(void);
+uint64_t cpucheck_u64random(void);
 
-void hex_dump(FILE *out, char const * const what, char const * const todump, const size_t len);
+void cpucheck_hex_dump(FILE *out, char const * const what, char const * const todump, const size_t len);
 
 #endif
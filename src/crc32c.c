@@ -0,0 +1,96 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#include <config.h>
+#include <string.h>
+#include <pthread.h>
+#include "crc32c.h"
+
+#define CRC32C_POLY 0x82f63b78
+
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+static uint32_t sw_table[256];
+static int has_sse42;
+
+static void crc32c_init(void)
+{
+	uint32_t i, j, crc;
+
+	for (i=0 ; i<256 ; i++) {
+		crc = i;
+		for (j=0 ; j<8 ; j++)
+			crc = crc & 1 ? crc >> 1 ^ CRC32C_POLY : crc >> 1;
+		sw_table[i] = crc;
+	}
+
+#if ARCH_X86_64
+	{
+		uint32_t ecx;
+
+		asm("movl $1, %%eax \n\t"
+			"cpuid \n\t"
+			: "=c" (ecx)
+			:
+			: "eax", "ebx", "edx"
+		);
+		has_sse42 = !!(ecx & 1<<20);
+	}
+#endif
+}
+
+static uint32_t crc32c_sw(uint32_t crc, uint8_t const *p, size_t len)
+{
+	while (len--)
+		crc = sw_table[(crc ^ *p++) & 0xff] ^ crc >> 8;
+
+	return crc;
+}
+
+#if ARCH_X86_64
+static uint32_t crc32c_hw(uint32_t crc, uint8_t const *p, size_t len)
+{
+	uint64_t crc64 = crc, word;
+
+	for ( ; len >= 8 ; len-=8, p+=8) {
+		memcpy(&word, p, 8);
+		asm("crc32q %[word], %[crc]" : [crc] "+r" (crc64) : [word] "rm" (word));
+	}
+	crc = crc64;
+	for ( ; len ; len--, p++)
+		asm("crc32b %[byte], %[crc]" : [crc] "+r" (crc) : [byte] "rm" (*p));
+
+	return crc;
+}
+#endif
+
+char const * cpucheck_crc32c_kernel(void)
+{
+	pthread_once(&crc32c_once, crc32c_init);
+
+	return has_sse42 ? "sse4.2 crc32" : "lookup table";
+}
+
+uint32_t cpucheck_crc32c(uint32_t crc, void const * const buf, size_t len)
+{
+	pthread_once(&crc32c_once, crc32c_init);
+
+	crc = ~crc;
+#if ARCH_X86_64
+	if (has_sse42)
+		return ~crc32c_hw(crc, buf, len);
+#endif
+	return ~crc32c_sw(crc, buf, len);
+}
@@ -0,0 +1,29 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Castagnoli CRC, using the SSE4.2 crc32 instruction when available.
+ * Start with crc=0 and chain calls to checksum discontiguous buffers. */
+uint32_t cpucheck_crc32c(uint32_t crc, void const * const buf, size_t len);
+/* Names the implementation cpucheck_crc32c() uses on this cpu */
+char const * cpucheck_crc32c_kernel(void);
+
+#endif
@@ -0,0 +1,193 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "governor.h"
+
+/* Cpu time a thread may spend in a row after having been idle */
+#define GOVERNOR_BURST_NS 20000000
+/* Longest sleep, so that pause and exit requests are noticed timely */
+#define GOVERNOR_MAX_SLEEP_NS 100000000
+#define RUNQUEUE_PERIOD_NS 1000000000
+/* Lowest fraction of the budget kept on overloaded hosts, per mille */
+#define RUNQUEUE_MIN_FACTOR 50
+
+static uint64_t runqueue_sampled;
+static unsigned int runqueue_factor = 1000;
+
+static uint64_t clock_ns(const clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Number of threads of this process currently runnable, the sampling one
+ * included */
+static unsigned int own_runnable(void)
+{
+	char path[64], buf[256], *state;
+	struct dirent *de;
+	unsigned int n = 0;
+	DIR *d;
+	FILE *f;
+
+	d = opendir("/proc/self/task");
+	if (!d)
+		return 0;
+	while ((de = readdir(d))) {
+		if (de->d_name[0] == '.')
+			continue;
+		snprintf(path, sizeof(path), "/proc/self/task/%.16s/stat", de->d_name);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+		/* The thread name may hold spaces and parentheses */
+		if (fgets(buf, sizeof(buf), f) && (state = strrchr(buf, ')')) && state[1] == ' ' && state[2] == 'R')
+			n++;
+		fclose(f);
+	}
+	closedir(d);
+
+	return n;
+}
+
+/* Reads the number of currently runnable tasks from /proc/loadavg, leaves
+ * out the threads of this process, and shrinks the budget of every governor
+ * when the others exceed the cpu count */
+static void sample_runqueue(const uint64_t now)
+{
+	uint64_t last = __atomic_load_n(&runqueue_sampled, __ATOMIC_RELAXED);
+	unsigned int running, own, factor = 1000;
+	long int cpus;
+	FILE *f;
+
+	if (now - last < RUNQUEUE_PERIOD_NS)
+		return;
+	if (!__atomic_compare_exchange_n(&runqueue_sampled, &last, now, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		return;
+
+	f = fopen("/proc/loadavg", "r");
+	if (!f)
+		return;
+	if (fscanf(f, "%*s %*s %*s %u/", &running) == 1) {
+		cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		/* Our own threads are what the budget caps, they must not
+		 * shrink it */
+		own = own_runnable();
+		running -= own < running ? own : running;
+		if (cpus > 0 && running > (unsigned long int)cpus) {
+			factor = 1000 * cpus / running;
+			if (factor < RUNQUEUE_MIN_FACTOR)
+				factor = RUNQUEUE_MIN_FACTOR;
+		}
+	}
+	fclose(f);
+
+	__atomic_store_n(&runqueue_factor, factor, __ATOMIC_RELAXED);
+}
+
+void governor_init(struct governor * const gov, const unsigned int budget)
+{
+	gov->budget = budget;
+	gov->tokens = 0;
+	gov->start_wall = gov->last_wall = clock_ns(CLOCK_MONOTONIC);
+	gov->start_cpu = gov->last_cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+}
+
+void governor_throttle(struct governor * const gov)
+{
+	const uint64_t wall = clock_ns(CLOCK_MONOTONIC);
+	const uint64_t cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+	double rate;
+	uint64_t sleep_ns;
+	struct timespec ts;
+
+	sample_runqueue(wall);
+	rate = gov->budget / 100. * __atomic_load_n(&runqueue_factor, __ATOMIC_RELAXED) / 1000.;
+
+	gov->tokens += (int64_t)((wall - gov->last_wall) * rate) - (int64_t)(cpu - gov->last_cpu);
+	if (gov->tokens > GOVERNOR_BURST_NS)
+		gov->tokens = GOVERNOR_BURST_NS;
+	gov->last_wall = wall;
+	gov->last_cpu = cpu;
+
+	if (gov->tokens >= 0)
+		return;
+
+	/* Sleeping refills the bucket on the next call */
+	sleep_ns = -gov->tokens / rate;
+	if (sleep_ns > GOVERNOR_MAX_SLEEP_NS)
+		sleep_ns = GOVERNOR_MAX_SLEEP_NS;
+	ts.tv_sec = sleep_ns / 1000000000;
+	ts.tv_nsec = sleep_ns % 1000000000;
+	nanosleep(&ts, NULL);
+}
+
+double governor_usage(struct governor const * const gov)
+{
+	const uint64_t wall = clock_ns(CLOCK_MONOTONIC) - gov->start_wall;
+
+	if (!wall)
+		return 0;
+	return 100. * (clock_ns(CLOCK_THREAD_CPUTIME_ID) - gov->start_cpu) / wall;
+}
+
+int set_thread_priority(const int idle, const int nice)
+{
+	if (idle) {
+#ifdef SCHED_IDLE
+		struct sched_param sp;
+		int r;
+
+		memset(&sp, 0, sizeof(sp));
+		r = pthread_setschedparam(pthread_self(), SCHED_IDLE, &sp);
+		if (r) {
+			fprintf(stderr, "Could not switch to SCHED_IDLE: %s\n", strerror(r));
+			return -1;
+		}
+#else
+		fprintf(stderr, "SCHED_IDLE is not supported on this system\n");
+		return -1;
+#endif
+	}
+
+	if (nice) {
+#ifdef SYS_gettid
+		/* On Linux, the nice value of a tid only applies to that thread */
+		if (setpriority(PRIO_PROCESS, syscall(SYS_gettid), nice)) {
+			fprintf(stderr, "Could not set nice level %d: %s\n", nice, strerror(errno));
+			return -1;
+		}
+#else
+		fprintf(stderr, "Per thread nice levels are not supported on this system\n");
+		return -1;
+#endif
+	}
+
+	return 0;
+}
@@ -0,0 +1,44 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <stdint.h>
+
+/* Per thread token bucket keeping the cpu time consumed by the calling
+ * thread under budget percent of wall time. The budget shrinks while the
+ * runnable tasks of other processes outnumber the cpus. */
+struct governor {
+	unsigned int budget;
+	int64_t tokens;
+	uint64_t last_wall;
+	uint64_t last_cpu;
+	uint64_t start_wall;
+	uint64_t start_cpu;
+};
+
+void governor_init(struct governor * const gov, const unsigned int budget);
+/* Sleeps as long as needed to stay within budget */
+void governor_throttle(struct governor * const gov);
+/* Percentage of wall time the thread spent on cpu since governor_init() */
+double governor_usage(struct governor const * const gov);
+
+/* Applies SCHED_IDLE if idle is set, then nice if not null, to the calling
+ * thread. Returns non-zero on failure. */
+int set_thread_priority(const int idle, const int nice);
+
+#endif
@@ -0,0 +1,745 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include "libcpucheck.h"
+#include "crc32c.h"
+
+extern struct cpucheck_checker cpucheck_checker_addsub;
+#if ARCH_X86_64
+extern struct cpucheck_checker cpucheck_checker_bitscan;
+extern struct cpucheck_checker cpucheck_checker_bittest;
+#endif
+extern struct cpucheck_checker cpucheck_checker_bool;
+#if ARCH_X86_64
+extern struct cpucheck_checker cpucheck_checker_cmps;
+extern struct cpucheck_checker cpucheck_checker_cmpxchg;
+extern struct cpucheck_checker cpucheck_checker_lea;
+extern struct cpucheck_checker cpucheck_checker_lodsstos;
+extern struct cpucheck_checker cpucheck_checker_lzcnt;
+extern struct cpucheck_checker cpucheck_checker_mpa;
+extern struct cpucheck_checker cpucheck_checker_mpa4096;
+#endif
+extern struct cpucheck_checker cpucheck_checker_muldiv;
+#if ARCH_X86_64
+extern struct cpucheck_checker cpucheck_checker_muldiv128;
+extern struct cpucheck_checker cpucheck_checker_signextend;
+#endif
+
+static struct cpucheck_checker const * const checkers[] = {
+	&cpucheck_checker_addsub,
+#if ARCH_X86_64
+	&cpucheck_checker_bitscan,
+	&cpucheck_checker_bittest,
+#endif
+	&cpucheck_checker_bool,
+#if ARCH_X86_64
+	&cpucheck_checker_cmps,
+	&cpucheck_checker_cmpxchg,
+	&cpucheck_checker_lea,
+	&cpucheck_checker_lodsstos,
+	&cpucheck_checker_lzcnt,
+	&cpucheck_checker_mpa,
+	&cpucheck_checker_mpa4096,
+#endif
+	&cpucheck_checker_muldiv,
+#if ARCH_X86_64
+	&cpucheck_checker_muldiv128,
+	&cpucheck_checker_signextend,
+#endif
+	NULL
+};
+
+/* Bytes covered by each table checksum, rounded to whole elements */
+#define SLICE_BYTES 65536
+
+enum verdict {
+	VERDICT_UNKNOWN,
+	VERDICT_CLEAN,
+	VERDICT_CORRUPTED,
+};
+
+#define NIBLE_COUNT(tofill, niblesz) ( (tofill)/(niblesz) + !!((tofill)%(niblesz)) )
+
+unsigned long int cpucheck_ulirandom(void)
+{
+	size_t i;
+	unsigned long int res;
+
+	for(i=res=0 ; i<NIBLE_COUNT(sizeof(unsigned long int)*8, RANDOM_NIBLE_SIZE) ; i++)
+		res |= random() << (i*RANDOM_NIBLE_SIZE);
+
+	return res;
+}
+
+uint64_t cpucheck_u64random(void)
+{
+	size_t i;
+	uint64_t res;
+
+	for(i=res=0 ; i<NIBLE_COUNT(sizeof(uint64_t)*8, RANDOM_NIBLE_SIZE) ; i++)
+		res |= (uint64_t) random() << (i*RANDOM_NIBLE_SIZE);
+
+	return res;
+}
+
+void cpucheck_hex_dump(FILE *out, char const * const what, char const * const todump, const size_t len)
+{
+	size_t i;
+
+	if (what)
+		fprintf(out, "%s\n", what);
+
+	for(i=0 ; i<len ; i++) {
+		if (!(i%16))
+			fprintf(out, "%04zx: ", i);
+
+		fprintf(out, "%02hhx ", *(todump+i));
+
+		if (i%8 == 7) {
+			fprintf(out, i%16 == 7 ? " " : "\n");
+		}
+	}
+
+	if (len%16)
+		fprintf(out, "\n");
+}
+
+struct cpucheck_table {
+	struct cpucheck_checker const * checker;
+	void *checker_conf;
+	size_t table_size;
+	void * table;
+	size_t slice_elts;
+	size_t nb_slices;
+	uint32_t *checksums;
+	/* Latest verdict of each slice, see enum verdict */
+	uint8_t *verdicts;
+	enum cpucheck_walk walk;
+	/* Stride walks go through stride columns, the first big_cols of them
+	 * holding col_len+1 elements, the others col_len */
+	size_t stride;
+	size_t big_cols;
+	size_t col_len;
+	/* Permuted walks cycle through a bijection of [0;perm_mask] */
+	uint64_t perm_mask;
+	uint64_t perm_key;
+	unsigned int perm_shift;
+};
+
+/* Position in the walk, and the element it maps to */
+struct walk_cursor {
+	size_t pos;
+	size_t idx;
+	size_t col;
+};
+
+struct cpucheck_worker {
+	struct cpucheck_table const * table;
+	struct walk_cursor cur;
+	/* Prefetch cursor, distance positions ahead of cur */
+	struct walk_cursor ahead;
+	size_t distance;
+	unsigned int repeat;
+	void *comp;
+	size_t comp_size;
+	cpucheck_error_handler on_error;
+	void *ctx;
+	unsigned long int inconsistencies;
+	unsigned long int checks;
+};
+
+/* failed holds the comp of the first inconsistency of the latest check */
+struct cpucheck_repro {
+	struct cpucheck_checker const * checker;
+	void *config;
+	void *element;
+	void *comp;
+	void *failed;
+};
+
+struct cpucheck_checker const * const * cpucheck_checkers(void)
+{
+	return checkers;
+}
+
+struct cpucheck_checker const * cpucheck_find_checker(char const * const name)
+{
+	struct cpucheck_checker const * const * tmpcheck;
+
+	for (tmpcheck = checkers ; *tmpcheck ; tmpcheck++) {
+		if (!strcmp(name, (*tmpcheck)->name))
+			return *tmpcheck;
+		if ((*tmpcheck)->compact && !strcmp(name, (*tmpcheck)->compact->name))
+			return (*tmpcheck)->compact;
+	}
+
+	return NULL;
+}
+
+static uint32_t slice_checksum(struct cpucheck_table const * const table, const size_t slice)
+{
+	const size_t start = slice*table->slice_elts;
+	size_t count = table->table_size - start;
+
+	if (count > table->slice_elts)
+		count = table->slice_elts;
+
+	return cpucheck_crc32c(0, (char*)table->table + start*table->checker->table_elt_size,
+			count*table->checker->table_elt_size);
+}
+
+struct cpucheck_table * cpucheck_table_new(struct cpucheck_checker const * const checker, const size_t table_size)
+{
+	struct cpucheck_table *table;
+	size_t i;
+
+	if (!table_size) {
+		fprintf(stderr, "Needs a non-null table size\n");
+		return NULL;
+	}
+	if (SIZE_MAX/checker->table_elt_size < table_size) {
+		fprintf(stderr, "Requested table size is too big\n");
+		return NULL;
+	}
+
+	table = malloc(sizeof(*table));
+	if (!table) {
+		fprintf(stderr, "Could not allocate table state\n");
+		return NULL;
+	}
+	table->checker = checker;
+
+	table->checker_conf = malloc(checker->config_size);
+	if (!table->checker_conf) {
+		fprintf(stderr,"Could not allocate checker config\n");
+		goto err_state;
+	}
+
+	table->table = malloc(table_size*checker->table_elt_size);
+	if (!table->table) {
+		fprintf(stderr, "Could not allocate table\n");
+		goto err_conf;
+	}
+	table->table_size = table_size;
+	table->walk = CPUCHECK_WALK_SEQ;
+
+	if (checker->init(table->checker_conf, table->table, table_size)) {
+		fprintf(stderr, "Error while initialising table\n");
+		goto err_table;
+	}
+
+	table->slice_elts = checker->table_elt_size < SLICE_BYTES ? SLICE_BYTES/checker->table_elt_size : 1;
+	table->nb_slices = table_size/table->slice_elts + !!(table_size%table->slice_elts);
+	table->checksums = malloc(sizeof(*table->checksums)*table->nb_slices);
+	table->verdicts = calloc(table->nb_slices, sizeof(*table->verdicts));
+	if (!table->checksums || !table->verdicts) {
+		fprintf(stderr, "Could not allocate table checksums\n");
+		goto err_init;
+	}
+	for (i=0 ; i<table->nb_slices ; i++)
+		table->checksums[i] = slice_checksum(table, i);
+
+	return table;
+
+err_init:
+	free(table->verdicts);
+	free(table->checksums);
+	if (checker->delete)
+		checker->delete(table->checker_conf, table->table, table_size);
+err_table:
+	free(table->table);
+err_conf:
+	free(table->checker_conf);
+err_state:
+	free(table);
+	return NULL;
+}
+
+void cpucheck_table_delete(struct cpucheck_table * const table)
+{
+	if (table->checker->delete)
+		table->checker->delete(table->checker_conf, table->table, table->table_size);
+	free(table->verdicts);
+	free(table->checksums);
+	free(table->table);
+	free(table->checker_conf);
+	free(table);
+}
+
+struct cpucheck_checker const * cpucheck_table_checker(struct cpucheck_table const * const table)
+{
+	return table->checker;
+}
+
+char const * cpucheck_table_kernel(struct cpucheck_table const * const table)
+{
+	if (!table->checker->kernel)
+		return NULL;
+
+	return table->checker->kernel(table->checker_conf);
+}
+
+char const * cpucheck_checksum_kernel(void)
+{
+	return cpucheck_crc32c_kernel();
+}
+
+size_t cpucheck_table_size(struct cpucheck_table const * const table)
+{
+	return table->table_size;
+}
+
+size_t cpucheck_table_slices(struct cpucheck_table const * const table)
+{
+	return table->nb_slices;
+}
+
+int cpucheck_table_verify_slice(struct cpucheck_table const * const table, const size_t slice)
+{
+	const int corrupted = slice_checksum(table, slice) != table->checksums[slice];
+
+	__atomic_store_n(&table->verdicts[slice], corrupted ? VERDICT_CORRUPTED : VERDICT_CLEAN, __ATOMIC_RELAXED);
+	return corrupted;
+}
+
+static size_t element_slice(struct cpucheck_table const * const table, void const * const table_element)
+{
+	return ((char const*)table_element - (char const*)table->table) / table->checker->table_elt_size / table->slice_elts;
+}
+
+int cpucheck_table_verify_element(struct cpucheck_table const * const table, void const * const table_element)
+{
+	return cpucheck_table_verify_slice(table, element_slice(table, table_element));
+}
+
+int cpucheck_table_verify_element_cached(struct cpucheck_table const * const table, void const * const table_element)
+{
+	const size_t slice = element_slice(table, table_element);
+
+	switch (__atomic_load_n(&table->verdicts[slice], __ATOMIC_RELAXED)) {
+		case VERDICT_CLEAN:
+			return 0;
+		case VERDICT_CORRUPTED:
+			return 1;
+		default:
+			return cpucheck_table_verify_slice(table, slice);
+	}
+}
+
+void * cpucheck_table_element(struct cpucheck_table * const table, const size_t idx)
+{
+	return (char*)table->table + idx%table->table_size*table->checker->table_elt_size;
+}
+
+int cpucheck_table_set_walk(struct cpucheck_table * const table, const enum cpucheck_walk walk, const size_t stride)
+{
+	unsigned int bits;
+
+	switch (walk) {
+		case CPUCHECK_WALK_SEQ:
+			break;
+		case CPUCHECK_WALK_STRIDE:
+			if (!stride) {
+				fprintf(stderr, "Needs a non-null stride\n");
+				return -1;
+			}
+			table->stride = stride < table->table_size ? stride : table->table_size;
+			table->big_cols = table->table_size % table->stride;
+			table->col_len = table->table_size / table->stride;
+			break;
+		case CPUCHECK_WALK_PERM:
+			for (bits=0 ; bits<64 && (table->table_size-1) >> bits ; bits++) ;
+			table->perm_mask = bits == 64 ? UINT64_MAX : (1ULL << bits) - 1;
+			table->perm_key = cpucheck_u64random();
+			table->perm_shift = bits/2 + 1;
+			break;
+		default:
+			fprintf(stderr, "Unknown walk\n");
+			return -1;
+	}
+	table->walk = walk;
+
+	return 0;
+}
+
+/* Each step is a bijection of [0;perm_mask], walking the cycle until it
+ * falls back in the table takes less than two steps on average */
+static size_t permute(struct cpucheck_table const * const table, uint64_t y)
+{
+	do {
+		y = (y * 0xd1342543de82ef95ULL + table->perm_key) & table->perm_mask;
+		y ^= y >> table->perm_shift;
+		y = (y * 0x9e3779b97f4a7c15ULL) & table->perm_mask;
+	} while (y >= table->table_size);
+
+	return y;
+}
+
+static void walk_seek(struct cpucheck_table const * const table, struct walk_cursor * const cur, const size_t pos)
+{
+	size_t first, k;
+
+	cur->pos = pos % table->table_size;
+	switch (table->walk) {
+		case CPUCHECK_WALK_SEQ:
+			cur->idx = cur->pos;
+			break;
+		case CPUCHECK_WALK_STRIDE:
+			first = table->big_cols * (table->col_len+1);
+			if (cur->pos < first) {
+				cur->col = cur->pos / (table->col_len+1);
+				k = cur->pos % (table->col_len+1);
+			} else {
+				cur->col = table->big_cols + (cur->pos-first) / table->col_len;
+				k = (cur->pos-first) % table->col_len;
+			}
+			cur->idx = cur->col + k*table->stride;
+			break;
+		case CPUCHECK_WALK_PERM:
+			cur->idx = permute(table, cur->pos);
+			break;
+	}
+}
+
+static inline void walk_next(struct cpucheck_table const * const table, struct walk_cursor * const cur)
+{
+	if (++cur->pos == table->table_size)
+		cur->pos = 0;
+
+	switch (table->walk) {
+		case CPUCHECK_WALK_SEQ:
+			cur->idx = cur->pos;
+			break;
+		case CPUCHECK_WALK_STRIDE:
+			if (!cur->pos)
+				cur->col = cur->idx = 0;
+			else if ((cur->idx += table->stride) >= table->table_size)
+				cur->idx = ++cur->col;
+			break;
+		case CPUCHECK_WALK_PERM:
+			cur->idx = permute(table, cur->pos);
+			break;
+	}
+}
+
+struct cpucheck_worker * cpucheck_worker_new(struct cpucheck_table const * const table, const size_t start_idx,
+		const cpucheck_error_handler on_error, void * const ctx)
+{
+	struct cpucheck_worker *worker;
+
+	worker = malloc(sizeof(*worker));
+	if (!worker) {
+		fprintf(stderr, "Could not allocate worker\n");
+		return NULL;
+	}
+
+	worker->comp_size = table->checker->comp_elt_size;
+	worker->comp = malloc(worker->comp_size);
+	if (!worker->comp) {
+		fprintf(stderr, "Could not allocate worker comp\n");
+		free(worker);
+		return NULL;
+	}
+
+	worker->table = table;
+	worker->distance = 0;
+	worker->repeat = 1;
+	walk_seek(table, &worker->cur, start_idx);
+	worker->on_error = on_error;
+	worker->ctx = ctx;
+	worker->inconsistencies = 0;
+	worker->checks = 0;
+
+	return worker;
+}
+
+void cpucheck_worker_delete(struct cpucheck_worker * const worker)
+{
+	free(worker->comp);
+	free(worker);
+}
+
+/* comp only grows, so that switching back to a previous table cannot fail */
+int cpucheck_worker_set_table(struct cpucheck_worker * const worker, struct cpucheck_table const * const table)
+{
+	if (table->checker->comp_elt_size > worker->comp_size) {
+		void * const comp = malloc(table->checker->comp_elt_size);
+
+		if (!comp) {
+			fprintf(stderr, "Could not allocate worker comp\n");
+			return -1;
+		}
+		free(worker->comp);
+		worker->comp = comp;
+		worker->comp_size = table->checker->comp_elt_size;
+	}
+
+	worker->table = table;
+	cpucheck_worker_seek(worker, worker->cur.pos);
+
+	return 0;
+}
+
+struct cpucheck_table const * cpucheck_worker_table(struct cpucheck_worker const * const worker)
+{
+	return worker->table;
+}
+
+void cpucheck_worker_seek(struct cpucheck_worker * const worker, const size_t idx)
+{
+	walk_seek(worker->table, &worker->cur, idx);
+	if (worker->distance)
+		walk_seek(worker->table, &worker->ahead, worker->cur.pos + worker->distance%worker->table->table_size);
+}
+
+void cpucheck_worker_set_repeat(struct cpucheck_worker * const worker, const unsigned int repeat)
+{
+	worker->repeat = repeat ? repeat : 1;
+}
+
+void cpucheck_worker_set_prefetch(struct cpucheck_worker * const worker, const size_t distance)
+{
+	worker->distance = distance;
+	cpucheck_worker_seek(worker, worker->cur.pos);
+}
+
+unsigned long int cpucheck_worker_step(struct cpucheck_worker * const worker, const size_t count)
+{
+	struct cpucheck_table const * const table = worker->table;
+	struct cpucheck_checker const * const checker = table->checker;
+	unsigned long int found = 0;
+	unsigned int rep;
+	size_t n;
+
+	for (n=0 ; n<count ; n++) {
+		void const * const elt = (char*)table->table + worker->cur.idx*checker->table_elt_size;
+		if (worker->distance) {
+			__builtin_prefetch((char*)table->table + worker->ahead.idx*checker->table_elt_size);
+			walk_next(table, &worker->ahead);
+		}
+		for (rep=0 ; rep<worker->repeat ; rep++) {
+			if (checker->check_item(worker->comp, table->checker_conf, elt)) {
+				found++;
+				if (ULONG_MAX-worker->inconsistencies)
+					worker->inconsistencies++;
+				if (worker->on_error)
+					worker->on_error(worker->ctx, worker, elt, worker->comp);
+			}
+			if (worker->checks < ULONG_MAX)
+				worker->checks++;
+		}
+		walk_next(table, &worker->cur);
+	}
+
+	return found;
+}
+
+unsigned long int cpucheck_worker_checks(struct cpucheck_worker const * const worker)
+{
+	return __atomic_load_n(&worker->checks, __ATOMIC_RELAXED);
+}
+
+unsigned long int cpucheck_worker_inconsistencies(struct cpucheck_worker const * const worker)
+{
+	return __atomic_load_n(&worker->inconsistencies, __ATOMIC_RELAXED);
+}
+
+void cpucheck_report_error(FILE *out, struct cpucheck_worker const * const worker,
+		void const * const table_element, void const * const comp)
+{
+	struct cpucheck_table const * const table = worker->table;
+
+	fprintf(out, "Inconsistency detected...\n");
+	if (table->checker->report_error)
+		table->checker->report_error(out, table->checker_conf, table_element, comp);
+}
+
+int cpucheck_diff(struct cpucheck_table const * const table, void const * const table_element,
+		void const * const comp, const cpucheck_diff_handler handler, void * const ctx)
+{
+	struct cpucheck_output const *output = table->checker->outputs;
+	int r = 0;
+
+	if (!output)
+		return -1;
+
+	for ( ; output->name ; output++) {
+		void const * const expected = (char const*)table_element + output->offset;
+		void const * const got = (char const*)comp + output->comp_offset;
+
+		if (output->computed && !output->computed(table->checker_conf))
+			continue;
+		if (!memcmp(expected, got, output->size))
+			continue;
+		handler(ctx, output, expected, got);
+		r++;
+	}
+
+	return r;
+}
+
+static struct cpucheck_repro * repro_alloc(struct cpucheck_checker const * const checker)
+{
+	struct cpucheck_repro *repro;
+
+	if (checker->delete) {
+		fprintf(stderr, "Elements of checker %s refer to memory outside the table, they cannot be copied\n",
+				checker->name);
+		return NULL;
+	}
+
+	repro = malloc(sizeof(*repro));
+	if (!repro) {
+		fprintf(stderr, "Could not allocate reproducer\n");
+		return NULL;
+	}
+	repro->checker = checker;
+	repro->config = malloc(checker->config_size);
+	repro->element = malloc(checker->table_elt_size);
+	repro->comp = malloc(checker->comp_elt_size);
+	repro->failed = calloc(1, checker->comp_elt_size);
+	if (!repro->config || !repro->element || !repro->comp || !repro->failed) {
+		fprintf(stderr, "Could not allocate reproducer\n");
+		cpucheck_repro_delete(repro);
+		return NULL;
+	}
+
+	return repro;
+}
+
+struct cpucheck_repro * cpucheck_repro_new(struct cpucheck_table const * const table, void const * const table_element)
+{
+	struct cpucheck_repro * const repro = repro_alloc(table->checker);
+
+	if (!repro)
+		return NULL;
+	memcpy(repro->config, table->checker_conf, table->checker->config_size);
+	memcpy(repro->element, table_element, table->checker->table_elt_size);
+
+	return repro;
+}
+
+void cpucheck_repro_delete(struct cpucheck_repro * const repro)
+{
+	free(repro->failed);
+	free(repro->comp);
+	free(repro->element);
+	free(repro->config);
+	free(repro);
+}
+
+struct cpucheck_checker const * cpucheck_repro_checker(struct cpucheck_repro const * const repro)
+{
+	return repro->checker;
+}
+
+unsigned long int cpucheck_repro_check(struct cpucheck_repro * const repro, const unsigned long int times)
+{
+	struct cpucheck_checker const * const checker = repro->checker;
+	unsigned long int n, found = 0;
+
+	for (n=0 ; n<times ; n++)
+		if (checker->check_item(repro->comp, repro->config, repro->element) && !found++)
+			memcpy(repro->failed, repro->comp, checker->comp_elt_size);
+
+	return found;
+}
+
+void cpucheck_repro_report_error(FILE *out, struct cpucheck_repro const * const repro)
+{
+	fprintf(out, "Inconsistency detected...\n");
+	if (repro->checker->report_error)
+		repro->checker->report_error(out, repro->config, repro->element, repro->failed);
+}
+
+static void save_hex(FILE *out, char const * const what, unsigned char const * const buf, const size_t len)
+{
+	size_t i;
+
+	fprintf(out, "%s ", what);
+	for (i=0 ; i<len ; i++)
+		fprintf(out, "%02x", buf[i]);
+	fprintf(out, "\n");
+}
+
+static int load_hex(FILE *in, char const * const what, unsigned char * const buf, const size_t len)
+{
+	char keyword[16];
+	size_t i;
+
+	if (fscanf(in, "%15s", keyword) != 1 || strcmp(keyword, what))
+		return -1;
+	for (i=0 ; i<len ; i++)
+		if (fscanf(in, "%2hhx", &buf[i]) != 1)
+			return -1;
+
+	return 0;
+}
+
+int cpucheck_repro_save(struct cpucheck_repro const * const repro, FILE *out)
+{
+	fprintf(out, "cpucheck-repro %u\n", CPUCHECK_REPRO_VERSION);
+	fprintf(out, "checker %s\n", repro->checker->name);
+	save_hex(out, "config", repro->config, repro->checker->config_size);
+	save_hex(out, "element", repro->element, repro->checker->table_elt_size);
+
+	if (fflush(out) || ferror(out)) {
+		fprintf(stderr, "Could not write reproducer\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+struct cpucheck_repro * cpucheck_repro_load(FILE *in)
+{
+	struct cpucheck_checker const *checker;
+	struct cpucheck_repro *repro;
+	char name[64];
+	unsigned int version;
+
+	if (fscanf(in, "cpucheck-repro %u", &version) != 1 || version != CPUCHECK_REPRO_VERSION) {
+		fprintf(stderr, "Not a reproducer, or of an unsupported version\n");
+		return NULL;
+	}
+	if (fscanf(in, " checker %63s", name) != 1) {
+		fprintf(stderr, "Reproducer does not name its checker\n");
+		return NULL;
+	}
+	checker = cpucheck_find_checker(name);
+	if (!checker) {
+		fprintf(stderr, "Checker %s not found\n", name);
+		return NULL;
+	}
+
+	repro = repro_alloc(checker);
+	if (!repro)
+		return NULL;
+	if (load_hex(in, "config", repro->config, checker->config_size)
+			|| load_hex(in, "element", repro->element, checker->table_elt_size)) {
+		fprintf(stderr, "Reproducer is truncated, or was saved by another build\n");
+		cpucheck_repro_delete(repro);
+		return NULL;
+	}
+
+	return repro;
+}
@@ -0,0 +1,134 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#ifndef LIBCPUCHECK_H
+#define LIBCPUCHECK_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "cpucheck.h"
+
+/* Embedding API: build a table once, then let each thread that wants to
+ * check its cpu own a worker and call cpucheck_worker_step() whenever it
+ * has spare time. Steps never block nor allocate.
+ *
+ * A table may be shared by any number of workers, and must outlive them.
+ * Functions returning an int return 0 on success, and print the reason on
+ * stderr before returning non-zero on failure. */
+
+struct cpucheck_table;
+struct cpucheck_worker;
+struct cpucheck_repro;
+
+/* Orders in which workers go through a table */
+enum cpucheck_walk {
+	CPUCHECK_WALK_SEQ,
+	/* Every stride-th element, then the same shifted by one, and so on */
+	CPUCHECK_WALK_STRIDE,
+	/* Pseudo-random permutation, drawn with each table */
+	CPUCHECK_WALK_PERM,
+};
+
+/* Called from cpucheck_worker_step() for each inconsistency */
+typedef void (*cpucheck_error_handler)(void * const ctx, struct cpucheck_worker const * const worker,
+		void const * const table_element, void const * const comp);
+
+/* Called from cpucheck_diff() for each output that differs from its
+ * expected value */
+typedef void (*cpucheck_diff_handler)(void * const ctx, struct cpucheck_output const * const output,
+		void const * const expected, void const * const got);
+
+/* NULL terminated list of the checkers available on this architecture */
+struct cpucheck_checker const * const * cpucheck_checkers(void);
+/* Also finds the compact variants, which are not listed */
+struct cpucheck_checker const * cpucheck_find_checker(char const * const name);
+
+struct cpucheck_table * cpucheck_table_new(struct cpucheck_checker const * const checker, const size_t table_size);
+void cpucheck_table_delete(struct cpucheck_table * const table);
+struct cpucheck_checker const * cpucheck_table_checker(struct cpucheck_table const * const table);
+size_t cpucheck_table_size(struct cpucheck_table const * const table);
+/* Instructions the checker was set up to use on this cpu, NULL if it has a
+ * single path */
+char const * cpucheck_table_kernel(struct cpucheck_table const * const table);
+/* Instructions table checksums are computed with on this cpu */
+char const * cpucheck_checksum_kernel(void);
+/* Tables are checksummed by slices of consecutive elements once built, so
+ * that corrupted elements can be told from miscomputed ones. Verifications
+ * return non-zero if the slice does not match its checksum anymore. */
+size_t cpucheck_table_slices(struct cpucheck_table const * const table);
+int cpucheck_table_verify_slice(struct cpucheck_table const * const table, const size_t slice);
+int cpucheck_table_verify_element(struct cpucheck_table const * const table, void const * const table_element);
+/* Reuses the verdict of the latest verification of the slice if any, for
+ * callers that cannot afford to checksum a slice each time. Verifying the
+ * slice again refreshes the verdict. */
+int cpucheck_table_verify_element_cached(struct cpucheck_table const * const table, void const * const table_element);
+/* Address of element idx, workers may be reading it concurrently */
+void * cpucheck_table_element(struct cpucheck_table * const table, const size_t idx);
+/* Tables are walked sequentially by default. Positions given to workers are
+ * mapped to elements by a bijection, so that going through every position
+ * checks every element once. Must be set before any worker uses the table. */
+int cpucheck_table_set_walk(struct cpucheck_table * const table, const enum cpucheck_walk walk, const size_t stride);
+
+/* Without an error handler, inconsistencies are only counted */
+struct cpucheck_worker * cpucheck_worker_new(struct cpucheck_table const * const table, const size_t start_idx,
+		const cpucheck_error_handler on_error, void * const ctx);
+void cpucheck_worker_delete(struct cpucheck_worker * const worker);
+/* Leaves the worker untouched on failure */
+int cpucheck_worker_set_table(struct cpucheck_worker * const worker, struct cpucheck_table const * const table);
+struct cpucheck_table const * cpucheck_worker_table(struct cpucheck_worker const * const worker);
+/* Sets the position the next step starts from, modulo the table size */
+void cpucheck_worker_seek(struct cpucheck_worker * const worker, const size_t idx);
+/* Checks each element repeat times in a row before moving to the next one,
+ * each repetition counting as a test. Defaults to 1. */
+void cpucheck_worker_set_repeat(struct cpucheck_worker * const worker, const unsigned int repeat);
+/* Prefetches the element distance positions ahead, 0 disables */
+void cpucheck_worker_set_prefetch(struct cpucheck_worker * const worker, const size_t distance);
+
+/* Checks count elements from where the previous step stopped, wrapping
+ * around the table. Returns the number of inconsistencies found. */
+unsigned long int cpucheck_worker_step(struct cpucheck_worker * const worker, const size_t count);
+
+/* Saturating counters, safe to read from any thread */
+unsigned long int cpucheck_worker_checks(struct cpucheck_worker const * const worker);
+unsigned long int cpucheck_worker_inconsistencies(struct cpucheck_worker const * const worker);
+
+/* Prints the standard inconsistency report */
+void cpucheck_report_error(FILE *out, struct cpucheck_worker const * const worker,
+		void const * const table_element, void const * const comp);
+
+/* Goes through the outputs comp holds for table_element. Returns the number
+ * of differing ones, -1 if the checker does not describe its outputs. */
+int cpucheck_diff(struct cpucheck_table const * const table, void const * const table_element,
+		void const * const comp, const cpucheck_diff_handler handler, void * const ctx);
+
+/* Reproducers hold a copy of one element and of its checker config, that can
+ * be checked on its own and outlives the table. Elements of checkers with a
+ * delete callback refer to memory outside the table and cannot be copied. */
+#define CPUCHECK_REPRO_VERSION 1
+
+struct cpucheck_repro * cpucheck_repro_new(struct cpucheck_table const * const table, void const * const table_element);
+void cpucheck_repro_delete(struct cpucheck_repro * const repro);
+struct cpucheck_checker const * cpucheck_repro_checker(struct cpucheck_repro const * const repro);
+/* Checks the element times times in a row, returns the number of
+ * inconsistencies */
+unsigned long int cpucheck_repro_check(struct cpucheck_repro * const repro, const unsigned long int times);
+/* Prints the standard report of the first inconsistency of the latest check */
+void cpucheck_repro_report_error(FILE *out, struct cpucheck_repro const * const repro);
+/* Text files, only loadable by builds with the same element layout */
+int cpucheck_repro_save(struct cpucheck_repro const * const repro, FILE *out);
+struct cpucheck_repro * cpucheck_repro_load(FILE *in);
+
+#endif
@@ -0,0 +1,434 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#if HAVE_SCHED_H
+#include <sched.h>
+#endif
+#include "litmus.h"
+
+#if ARCH_X86_64
+
+#define CACHE_LINE_SIZE 64
+#define MAX_THREADS 4
+#define MAX_REGS 2
+#define BATCH_SIZE 1024
+#define SPINS_BEFORE_YIELD (1UL<<16)
+
+/* Each iteration works on fresh locations, x and y in distinct lines */
+struct inst {
+	uint64_t x;
+	char pad_x[CACHE_LINE_SIZE-sizeof(uint64_t)];
+	uint64_t y;
+	char pad_y[CACHE_LINE_SIZE-sizeof(uint64_t)];
+};
+
+typedef void (*role_func)(struct inst * const inst, uint8_t * const r);
+
+/* Outcomes are encoded with bit (thread*MAX_REGS+reg) set when the
+ * register read 1. A test is about the outcome matching target on the
+ * bits in mask, which x86-TSO either allows or forbids. */
+struct shape {
+	char const * const name;
+	const unsigned int threads;
+	const role_func roles[MAX_THREADS];
+	const unsigned int mask;
+	const unsigned int target;
+	const int forbidden;
+};
+
+#define REG(thread, reg) (1U << ((thread)*MAX_REGS+(reg)))
+
+static void store_x(struct inst * const inst, uint8_t * const r)
+{
+	asm volatile("movq $1, %[x] \n\t"
+		: [x] "=m" (inst->x)
+		:
+		: "memory"
+	);
+}
+
+static void store_y(struct inst * const inst, uint8_t * const r)
+{
+	asm volatile("movq $1, %[y] \n\t"
+		: [y] "=m" (inst->y)
+		:
+		: "memory"
+	);
+}
+
+static void mp_writer(struct inst * const inst, uint8_t * const r)
+{
+	asm volatile("movq $1, %[x] \n\t"
+		"movq $1, %[y] \n\t"
+		: [x] "=m" (inst->x), [y] "=m" (inst->y)
+		:
+		: "memory"
+	);
+}
+
+static void load_y_x(struct inst * const inst, uint8_t * const r)
+{
+	uint64_t r0, r1;
+
+	asm volatile("movq %[y], %[r0] \n\t"
+		"movq %[x], %[r1] \n\t"
+		: [r0] "=&r" (r0), [r1] "=&r" (r1)
+		: [x] "m" (inst->x), [y] "m" (inst->y)
+		: "memory"
+	);
+	r[0] = r0;
+	r[1] = r1;
+}
+
+static void load_x_y(struct inst * const inst, uint8_t * const r)
+{
+	uint64_t r0, r1;
+
+	asm volatile("movq %[x], %[r0] \n\t"
+		"movq %[y], %[r1] \n\t"
+		: [r0] "=&r" (r0), [r1] "=&r" (r1)
+		: [x] "m" (inst->x), [y] "m" (inst->y)
+		: "memory"
+	);
+	r[0] = r0;
+	r[1] = r1;
+}
+
+#define SB_ROLE(arg_name, arg_store, arg_load, arg_fence) \
+static void arg_name(struct inst * const inst, uint8_t * const r) \
+{ \
+	uint64_t r0 = 1; \
+	\
+	asm volatile(arg_fence \
+		"movq %[ld], %[r0] \n\t" \
+		: [r0] "+&r" (r0), [st] "+m" (inst->arg_store) \
+		: [ld] "m" (inst->arg_load) \
+		: "memory" \
+	); \
+	r[0] = r0; \
+}
+
+SB_ROLE(sb_x, x, y, "movq $1, %[st] \n\t")
+SB_ROLE(sb_y, y, x, "movq $1, %[st] \n\t")
+SB_ROLE(sb_mfence_x, x, y, "movq $1, %[st] \n\t" "mfence \n\t")
+SB_ROLE(sb_mfence_y, y, x, "movq $1, %[st] \n\t" "mfence \n\t")
+SB_ROLE(sb_xchg_x, x, y, "xchgq %[r0], %[st] \n\t")
+SB_ROLE(sb_xchg_y, y, x, "xchgq %[r0], %[st] \n\t")
+SB_ROLE(sb_lockor_x, x, y, "movq $1, %[st] \n\t" "lock orq $0, (%%rsp) \n\t")
+SB_ROLE(sb_lockor_y, y, x, "movq $1, %[st] \n\t" "lock orq $0, (%%rsp) \n\t")
+#undef SB_ROLE
+
+#define LB_ROLE(arg_name, arg_load, arg_store) \
+static void arg_name(struct inst * const inst, uint8_t * const r) \
+{ \
+	uint64_t r0; \
+	\
+	asm volatile("movq %[ld], %[r0] \n\t" \
+		"movq $1, %[st] \n\t" \
+		: [r0] "=&r" (r0), [st] "=m" (inst->arg_store) \
+		: [ld] "m" (inst->arg_load) \
+		: "memory" \
+	); \
+	r[0] = r0; \
+}
+
+LB_ROLE(lb_x, x, y)
+LB_ROLE(lb_y, y, x)
+#undef LB_ROLE
+
+static struct shape const shapes[] = {
+	{ "MP", 2, { mp_writer, load_y_x }, REG(1, 0)|REG(1, 1), REG(1, 0), 1 },
+	{ "SB", 2, { sb_x, sb_y }, REG(0, 0)|REG(1, 0), 0, 0 },
+	{ "SB+mfence", 2, { sb_mfence_x, sb_mfence_y }, REG(0, 0)|REG(1, 0), 0, 1 },
+	{ "SB+xchg", 2, { sb_xchg_x, sb_xchg_y }, REG(0, 0)|REG(1, 0), 0, 1 },
+	{ "SB+lockor", 2, { sb_lockor_x, sb_lockor_y }, REG(0, 0)|REG(1, 0), 0, 1 },
+	{ "LB", 2, { lb_x, lb_y }, REG(0, 0)|REG(1, 0), REG(0, 0)|REG(1, 0), 1 },
+	{ "IRIW", 4, { store_x, store_y, load_x_y, load_y_x },
+		REG(2, 0)|REG(2, 1)|REG(3, 0)|REG(3, 1), REG(2, 0)|REG(3, 0), 1 },
+};
+
+#define SHAPE_COUNT (sizeof(shapes)/sizeof(shapes[0]))
+
+struct barrier {
+	unsigned int count;
+	unsigned int sense;
+	unsigned int threads;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct test;
+
+struct worker {
+	pthread_t thread;
+	struct test *test;
+	unsigned int idx;
+	int cpu;
+	uint8_t res[BATCH_SIZE][MAX_REGS];
+};
+
+struct test {
+	struct barrier barrier;
+	struct shape const *shape;
+	struct inst *insts;
+	unsigned long int batches;
+	volatile int const *should_stop;
+	int stopped;
+	/* Set when not all threads could be spawned, so that those waiting in
+	 * the barrier leave it */
+	int aborted;
+	int pin_failed;
+	unsigned long int iterations;
+	unsigned long int hits;
+	struct worker workers[MAX_THREADS];
+};
+
+/* Returns -1 if aborted is set while waiting */
+static int barrier_wait(struct barrier * const b, unsigned int * const local_sense, int const * const aborted)
+{
+	const unsigned int sense = *local_sense = !*local_sense;
+	unsigned long int spins;
+
+	if (__atomic_add_fetch(&b->count, 1, __ATOMIC_ACQ_REL) == b->threads) {
+		__atomic_store_n(&b->count, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&b->sense, sense, __ATOMIC_RELEASE);
+		return 0;
+	}
+
+	for (spins=0 ; __atomic_load_n(&b->sense, __ATOMIC_ACQUIRE) != sense ; spins++) {
+		if (__atomic_load_n(aborted, __ATOMIC_RELAXED))
+			return -1;
+		if (spins >= SPINS_BEFORE_YIELD)
+			sched_yield();
+	}
+
+	return 0;
+}
+
+static void tally_batch(struct test * const test)
+{
+	unsigned int i, t, k, outcome;
+
+	for (i=0 ; i<BATCH_SIZE ; i++) {
+		for (outcome=0, t=0 ; t<test->shape->threads ; t++)
+			for (k=0 ; k<MAX_REGS ; k++)
+				if (test->workers[t].res[i][k])
+					outcome |= REG(t, k);
+		if ((outcome & test->shape->mask) == test->shape->target)
+			test->hits++;
+		test->insts[i].x = test->insts[i].y = 0;
+	}
+	test->iterations += BATCH_SIZE;
+}
+
+static void * worker_func(void *arg)
+{
+	struct worker * const w = arg;
+	struct test * const test = w->test;
+	const role_func role = test->shape->roles[w->idx];
+	unsigned int sense = 0;
+	unsigned long int batch;
+	size_t i;
+
+	if (pin_thread(pthread_self(), w->cpu))
+		__atomic_store_n(&test->pin_failed, 1, __ATOMIC_RELAXED);
+
+	for (batch=0 ; batch<test->batches ; batch++) {
+		for (i=0 ; i<BATCH_SIZE ; i++) {
+			if (barrier_wait(&test->barrier, &sense, &test->aborted))
+				return NULL;
+			role(&test->insts[i], w->res[i]);
+		}
+
+		if (barrier_wait(&test->barrier, &sense, &test->aborted))
+			return NULL;
+		if (!w->idx) {
+			tally_batch(test);
+			test->stopped = *test->should_stop;
+		}
+		if (barrier_wait(&test->barrier, &sense, &test->aborted))
+			return NULL;
+
+		if (test->stopped)
+			break;
+	}
+
+	return NULL;
+}
+
+static int run_test(struct test * const test, struct shape const * const shape, int const * const cpus,
+		const unsigned long int iterations, volatile int const * const should_stop)
+{
+	struct inst * const insts = test->insts;
+	unsigned int t;
+
+	memset(test, 0, sizeof(*test));
+	test->insts = insts;
+	memset(test->insts, 0, sizeof(*test->insts)*BATCH_SIZE);
+	test->barrier.threads = shape->threads;
+	test->shape = shape;
+	test->batches = iterations/BATCH_SIZE + !!(iterations%BATCH_SIZE);
+	test->should_stop = should_stop;
+
+	for (t=0 ; t<shape->threads ; t++) {
+		test->workers[t].test = test;
+		test->workers[t].idx = t;
+		test->workers[t].cpu = cpus[t];
+	}
+
+	for (t=0 ; t<shape->threads ; t++) {
+		if (pthread_create(&test->workers[t].thread, NULL, worker_func, &test->workers[t])) {
+			fprintf(stderr, "Issue when spawning thread\n");
+			goto err_threads;
+		}
+	}
+
+	for (t=0 ; t<shape->threads ; t++)
+		pthread_join(test->workers[t].thread, NULL);
+
+	return 0;
+
+err_threads:
+	/* The barrier never fills up, get the spawned threads out of it */
+	__atomic_store_n(&test->aborted, 1, __ATOMIC_RELAXED);
+	while (t--)
+		pthread_join(test->workers[t].thread, NULL);
+
+	return -1;
+}
+
+/* Picks the cpus of a test: a and b first, then the next distinct ones */
+static int pick_cpus(int * const picked, const unsigned int threads,
+		struct cpu_topo const * const cpus, const unsigned int count,
+		const unsigned int a, const unsigned int b)
+{
+	unsigned int t, i;
+
+	if (threads > count)
+		return -1;
+
+	picked[0] = cpus[a].cpu;
+	picked[1] = cpus[b].cpu;
+	for (t=2, i=(b+1)%count ; t<threads ; i=(i+1)%count)
+		if (i != a && i != b)
+			picked[t++] = cpus[i].cpu;
+
+	return 0;
+}
+
+long int litmus_run(FILE *out, struct cpu_topo const * const cpus, const unsigned int count,
+		const unsigned long int iterations, volatile int const * const should_stop,
+		unsigned long int * const tests)
+{
+	struct test *test;
+	unsigned long int totals[SHAPE_COUNT], hits[SHAPE_COUNT];
+	long int forbidden = 0;
+	int picked[MAX_THREADS];
+	unsigned int a, b, s, t;
+	struct timespec start, end;
+	double elapsed;
+
+	if (count < 2) {
+		fprintf(stderr, "Litmus tests need at least two cpus\n");
+		return -1;
+	}
+	if (!iterations) {
+		fprintf(stderr, "Needs a non-null iteration count\n");
+		return -1;
+	}
+
+	test = malloc(sizeof(*test));
+	if (!test) {
+		fprintf(stderr, "Could not allocate litmus test state\n");
+		return -1;
+	}
+	if (posix_memalign((void**)&test->insts, CACHE_LINE_SIZE, sizeof(*test->insts)*BATCH_SIZE)) {
+		fprintf(stderr, "Could not allocate litmus locations\n");
+		free(test);
+		return -1;
+	}
+
+	memset(totals, 0, sizeof(totals));
+	memset(hits, 0, sizeof(hits));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (!*should_stop) {
+		for (a=0 ; a<count && !*should_stop ; a++) {
+			for (b=0 ; b<count && !*should_stop ; b++) {
+				if (a == b)
+					continue;
+				for (s=0 ; s<SHAPE_COUNT && !*should_stop ; s++) {
+					if (pick_cpus(picked, shapes[s].threads, cpus, count, a, b))
+						continue;
+
+					if (run_test(test, &shapes[s], picked, iterations, should_stop)) {
+						forbidden = -1;
+						goto out;
+					}
+					if (test->pin_failed)
+						fprintf(stderr, "Could not pin %s threads, results are meaningless\n", shapes[s].name);
+
+					totals[s] += test->iterations;
+					hits[s] += test->hits;
+					if (shapes[s].forbidden && test->hits) {
+						fprintf(stderr, "Inconsistency detected...\n");
+						fprintf(stderr, "%s: %lu forbidden outcomes over %lu iterations on cpus",
+								shapes[s].name, test->hits, test->iterations);
+						for (t=0 ; t<shapes[s].threads ; t++)
+							fprintf(stderr, " %d", picked[t]);
+						fprintf(stderr, "\n");
+						forbidden += test->hits;
+					}
+				}
+			}
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	elapsed = (end.tv_sec-start.tv_sec) + (end.tv_nsec-start.tv_nsec)/1e9;
+
+	fprintf(out, "test,iterations,target_outcomes,per_million,status\n");
+	for (*tests=0, s=0 ; s<SHAPE_COUNT ; s++) {
+		fprintf(out, "%s,%lu,%lu,%.3f,%s\n", shapes[s].name, totals[s], hits[s],
+				totals[s] ? hits[s]*1e6/totals[s] : 0.,
+				shapes[s].forbidden ? (hits[s] ? "FORBIDDEN" : "ok") : "allowed");
+		*tests += totals[s];
+	}
+	fprintf(out, "# %.0f iterations per second\n", elapsed > 0 ? *tests/elapsed : 0.);
+
+out:
+	free(test->insts);
+	free(test);
+
+	return forbidden;
+}
+
+#else	/* ARCH_X86_64 */
+
+long int litmus_run(FILE *out, struct cpu_topo const * const cpus, const unsigned int count,
+		const unsigned long int iterations, volatile int const * const should_stop,
+		unsigned long int * const tests)
+{
+	fprintf(stderr, "Litmus tests are only available on x86_64\n");
+	return -1;
+}
+
+#endif	/* ARCH_X86_64 */
@@ -0,0 +1,31 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#ifndef LITMUS_H
+#define LITMUS_H
+
+#include <stdio.h>
+#include "topology.h"
+
+/* Runs x86-TSO litmus tests on every ordered pair of cpus, iterations times
+ * per test and pair, round after round until *should_stop is set.
+ * Prints a per test summary on out, *tests gets the total iteration count.
+ * Returns the number of forbidden outcomes observed, or -1 on error. */
+long int litmus_run(FILE *out, struct cpu_topo const * const cpus, const unsigned int count,
+		const unsigned long int iterations, volatile int const * const should_stop,
+		unsigned long int * const tests);
+
+#endif
@@ -0,0 +1,59 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "outliers.h"
+
+static int cmp_double(void const * const a, void const * const b)
+{
+	return *(double const*)a < *(double const*)b ? -1 : *(double const*)a > *(double const*)b;
+}
+
+/* Sorts values in place */
+static double median(double * const values, const unsigned int n)
+{
+	qsort(values, n, sizeof(*values), cmp_double);
+	return n%2 ? values[n/2] : (values[n/2-1] + values[n/2]) / 2;
+}
+
+double outliers_scores(double const * const values, const unsigned int n, double * const scores)
+{
+	double med, mad;
+	unsigned int i;
+
+	if (!n)
+		return 0;
+
+	/* scores doubles as scratch space */
+	memcpy(scores, values, sizeof(*scores)*n);
+	med = median(scores, n);
+	for (i=0 ; i<n ; i++)
+		scores[i] = fabs(values[i] - med);
+	mad = median(scores, n);
+
+	for (i=0 ; i<n ; i++) {
+		if (mad > 0)
+			scores[i] = 0.6745 * (values[i] - med) / mad;
+		else
+			scores[i] = values[i] > med ? HUGE_VAL : values[i] < med ? -HUGE_VAL : 0;
+	}
+
+	return med;
+}
@@ -0,0 +1,30 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+
+#ifndef OUTLIERS_H
+#define OUTLIERS_H
+
+/* Modified z-score above which a value is an outlier (Iglewicz and Hoaglin) */
+#define OUTLIERS_THRESHOLD 3.5
+
+/* Scores each of the n values by its modified z-score,
+ * 0.6745*(value-median)/MAD, MAD being the median absolute deviation from
+ * the median. Values differing from the median while MAD is null score
+ * +-HUGE_VAL. Returns the median, scores must hold n values. */
+double outliers_scores(double const * const values, const unsigned int n, double * const scores);
+
+#endif
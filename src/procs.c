@@ -0,0 +1,315 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "procs.h"
+
+#define min(a, b) ((a)<(b)?(a):(b))
+
+/* Checks between two counter updates and looks at the stop flag */
+#define PROCS_BATCH 4096
+#define SUPERVISOR_TICK_NS 100000000
+/* Delay before restarting the process of a cpu, so that a cpu faulting
+ * right away does not keep the supervisor forking */
+#define RESTART_DELAY_NS 1000000000ULL
+
+/* Written by the worker process of a cpu, read by the supervisor */
+struct proc_slot {
+	unsigned long int checks;
+	unsigned long int inconsistencies;
+	unsigned long int reported;
+	/* Fault signal caught by the worker, 0 if none */
+	int signo;
+	int code;
+	void *addr;
+} __attribute__((aligned(64)));
+
+struct procs_shared {
+	int should_exit;
+	struct proc_slot slots[];
+};
+
+/* Supervisor side of a cpu */
+struct proc {
+	int cpu;
+	pid_t pid;
+	uint64_t died_ns;
+	unsigned int deaths;
+	int excluded;
+	/* Counters of the processes that exited */
+	unsigned long int checks;
+	unsigned long int inconsistencies;
+};
+
+/* Worker process state, only valid in the children */
+static struct proc_slot *own_slot;
+static unsigned long int max_reports;
+static int own_cpu;
+
+static uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+/* Records the fault for the supervisor, then dies from it */
+static void fault_handler(int signo, siginfo_t *info, void *uctx)
+{
+	__atomic_store_n(&own_slot->code, info->si_code, __ATOMIC_RELAXED);
+	__atomic_store_n(&own_slot->addr, info->si_addr, __ATOMIC_RELAXED);
+	__atomic_store_n(&own_slot->signo, signo, __ATOMIC_RELEASE);
+	raise(signo);
+}
+
+/* Each report is written at once, so that reports of several processes do
+ * not interleave */
+static void on_error(void * const ctx, struct cpucheck_worker const * const worker,
+		void const * const table_element, void const * const comp)
+{
+	char *buf;
+	size_t len;
+	FILE *f;
+
+	if (own_slot->reported >= max_reports)
+		return;
+	own_slot->reported++;
+
+	f = open_memstream(&buf, &len);
+	if (!f)
+		return;
+	cpucheck_report_error(f, worker, table_element, comp);
+	fprintf(f, "Compute mismatch on cpu %d\n", own_cpu);
+	if (own_slot->reported == max_reports)
+		fprintf(f, "Further inconsistencies on cpu %d are only counted\n", own_cpu);
+	fclose(f);
+	fwrite(buf, 1, len, stderr);
+	fflush(stderr);
+	free(buf);
+}
+
+static void worker_process(struct procs_shared * const shared, const unsigned int slot, const int cpu,
+		struct cpucheck_table const * const table, const unsigned int repeat, const size_t prefetch,
+		volatile int const * const should_stop, const size_t start)
+{
+	static int const faults[] = { SIGILL, SIGSEGV, SIGBUS, SIGFPE };
+	struct cpucheck_worker *worker;
+	struct sigaction sa;
+	unsigned int i;
+
+	own_slot = &shared->slots[slot];
+	own_cpu = cpu;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = fault_handler;
+	sa.sa_flags = SA_SIGINFO | SA_RESETHAND | SA_NODEFER;
+	for (i=0 ; i<sizeof(faults)/sizeof(faults[0]) ; i++)
+		sigaction(faults[i], &sa, NULL);
+
+	if (pin_thread(pthread_self(), cpu)) {
+		fprintf(stderr, "Could not pin worker process on cpu %d\n", cpu);
+		_exit(EXIT_FAILURE);
+	}
+
+	worker = cpucheck_worker_new(table, start, on_error, NULL);
+	if (!worker)
+		_exit(EXIT_FAILURE);
+	cpucheck_worker_set_repeat(worker, repeat);
+	if (prefetch)
+		cpucheck_worker_set_prefetch(worker, prefetch);
+
+	while (!__atomic_load_n(&shared->should_exit, __ATOMIC_RELAXED) && !*should_stop) {
+		cpucheck_worker_step(worker, PROCS_BATCH);
+		__atomic_store_n(&own_slot->checks, cpucheck_worker_checks(worker), __ATOMIC_RELAXED);
+		__atomic_store_n(&own_slot->inconsistencies, cpucheck_worker_inconsistencies(worker), __ATOMIC_RELAXED);
+	}
+
+	cpucheck_worker_delete(worker);
+	_exit(EXIT_SUCCESS);
+}
+
+static int spawn(struct procs_shared * const shared, struct proc * const procs, const unsigned int slot,
+		const unsigned int count, struct cpucheck_table const * const table, const unsigned int repeat,
+		const size_t prefetch, volatile int const * const should_stop)
+{
+	struct proc * const p = &procs[slot];
+
+	memset(&shared->slots[slot], 0, sizeof(shared->slots[slot]));
+
+	/* Buffered output would be written again by the child */
+	fflush(NULL);
+	p->pid = fork();
+	if (p->pid == -1) {
+		fprintf(stderr, "Could not fork worker process for cpu %d\n", p->cpu);
+		return -1;
+	}
+	if (!p->pid)
+		worker_process(shared, slot, p->cpu, table, repeat, prefetch, should_stop,
+				cpucheck_table_size(table)/count*slot + random()%PROCS_BATCH);
+
+	return 0;
+}
+
+/* Accounts for the counters of the process of slot, which exited */
+static void retire(struct procs_shared const * const shared, struct proc * const p, const unsigned int slot)
+{
+	struct proc_slot const * const s = &shared->slots[slot];
+
+	p->checks += min(ULONG_MAX-p->checks, __atomic_load_n(&s->checks, __ATOMIC_RELAXED));
+	p->inconsistencies += min(ULONG_MAX-p->inconsistencies, __atomic_load_n(&s->inconsistencies, __ATOMIC_RELAXED));
+	p->pid = 0;
+}
+
+static void report_death(FILE *out, struct procs_shared const * const shared, struct proc const * const p,
+		const unsigned int slot, const int status)
+{
+	struct proc_slot const * const s = &shared->slots[slot];
+	const int signo = __atomic_load_n(&s->signo, __ATOMIC_ACQUIRE);
+
+	if (!WIFSIGNALED(status)) {
+		fprintf(out, "Worker process on cpu %d exited with status %d\n", p->cpu, WEXITSTATUS(status));
+		return;
+	}
+
+	fprintf(out, "Worker process on cpu %d killed by signal %d (%s)", p->cpu, WTERMSIG(status), strsignal(WTERMSIG(status)));
+	/* Signals sent by other processes have no fault address */
+	if (signo == WTERMSIG(status) && s->code > 0) {
+		fprintf(out, ", code %d at %p", s->code, s->addr);
+#ifdef BUS_MCEERR_AR
+		if (signo == SIGBUS && (s->code == BUS_MCEERR_AR || s->code == BUS_MCEERR_AO))
+			fprintf(out, ", machine check memory error");
+#endif
+	}
+	fprintf(out, "\n");
+}
+
+long int procs_run(FILE *out, struct cpu_topo const * const cpus, const unsigned int count,
+		struct cpucheck_table const * const table, const unsigned int repeat, const size_t prefetch,
+		const unsigned long int reports, const int exclude, volatile int const * const should_stop,
+		unsigned long int * const checks)
+{
+	struct timespec tick = { .tv_sec = 0, .tv_nsec = SUPERVISOR_TICK_NS };
+	struct procs_shared *shared;
+	struct proc *procs;
+	const size_t shared_size = sizeof(*shared) + count*sizeof(*shared->slots);
+	unsigned long int inc_cnt = 0, check_cnt = 0, deaths = 0;
+	unsigned int i, running = 0, waiting;
+	int status;
+	pid_t pid;
+	long int r = -1;
+
+	shared = mmap(NULL, shared_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+	if (shared == MAP_FAILED) {
+		fprintf(stderr, "Could not map worker process counters\n");
+		return -1;
+	}
+	shared->should_exit = 0;
+
+	procs = calloc(count, sizeof(*procs));
+	if (!procs) {
+		fprintf(stderr, "Could not allocate worker process states\n");
+		goto err_shared;
+	}
+
+	max_reports = reports;
+	for (i=0 ; i<count ; i++) {
+		procs[i].cpu = cpus[i].cpu;
+		if (spawn(shared, procs, i, count, table, repeat, prefetch, should_stop))
+			goto err_procs;
+		running++;
+	}
+
+	for (;;) {
+		if (*should_stop)
+			__atomic_store_n(&shared->should_exit, 1, __ATOMIC_RELAXED);
+
+		while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+			for (i=0 ; i<count && procs[i].pid != pid ; i++) ;
+			if (i == count)
+				continue;
+			retire(shared, &procs[i], i);
+			running--;
+			if (WIFEXITED(status) && !WEXITSTATUS(status))
+				continue;
+
+			report_death(out, shared, &procs[i], i, status);
+			procs[i].died_ns = monotonic_ns();
+			procs[i].deaths++;
+			deaths++;
+			/* Exit failures would fail again */
+			if (exclude || !WIFSIGNALED(status)) {
+				procs[i].excluded = 1;
+				fprintf(out, "Leaving cpu %d out\n", procs[i].cpu);
+			}
+		}
+
+		for (i=0, waiting=0 ; i<count && !*should_stop ; i++) {
+			if (procs[i].pid || procs[i].excluded)
+				continue;
+			if (monotonic_ns() - procs[i].died_ns < RESTART_DELAY_NS) {
+				waiting++;
+				continue;
+			}
+			if (spawn(shared, procs, i, count, table, repeat, prefetch, should_stop)) {
+				procs[i].excluded = 1;
+				continue;
+			}
+			running++;
+		}
+
+		if (!running && (!waiting || *should_stop))
+			break;
+		nanosleep(&tick, NULL);
+	}
+
+	for (i=0 ; i<count ; i++) {
+		inc_cnt += min(ULONG_MAX-inc_cnt, procs[i].inconsistencies);
+		check_cnt += min(ULONG_MAX-check_cnt, procs[i].checks);
+		if (procs[i].deaths)
+			fprintf(out, "Worker processes on cpu %d died %u times%s\n", procs[i].cpu, procs[i].deaths,
+					procs[i].excluded ? ", then it was left out" : "");
+	}
+	if (!deaths)
+		fprintf(out, "No worker process died\n");
+
+	*checks = check_cnt;
+	r = inc_cnt > LONG_MAX ? LONG_MAX : (long int)inc_cnt;
+
+err_procs:
+	/* Only reached with running processes on error */
+	if (r < 0) {
+		__atomic_store_n(&shared->should_exit, 1, __ATOMIC_RELAXED);
+		while (running && wait(NULL) > 0)
+			running--;
+	}
+	free(procs);
+err_shared:
+	munmap(shared, shared_size);
+	return r;
+}
@@ -0,0 +1,38 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+
+#ifndef PROCS_H
+#define PROCS_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "libcpucheck.h"
+#include "topology.h"
+
+/* Checks table from one forked process per cpu, each pinned on its cpu, so
+ * that a fault signal only takes one cpu down. Processes share the table
+ * pages built by the caller, and publish their counters in a shared mapping.
+ * The supervisor reports processes killed by a signal and restarts them,
+ * unless exclude is set, in which case their cpu is left out for the rest of
+ * the run. At most reports full inconsistency reports are printed per cpu.
+ * Returns the number of inconsistencies, or -1 on error. */
+long int procs_run(FILE *out, struct cpu_topo const * const cpus, const unsigned int count,
+		struct cpucheck_table const * const table, const unsigned int repeat, const size_t prefetch,
+		const unsigned long int reports, const int exclude, volatile int const * const should_stop,
+		unsigned long int * const checks);
+
+#endif
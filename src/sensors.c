@@ -0,0 +1,334 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include "topology.h"
+#include "sensors.h"
+
+#define SYSFS_CPU "/sys/devices/system/cpu"
+#define SYSFS_HWMON "/sys/class/hwmon"
+#define SYSFS_THERMAL "/sys/class/thermal"
+#define MSR_MPERF 0xe7
+#define MSR_APERF 0xe8
+
+struct temp_input {
+	int package;
+	int core;	/* -1 for package sensors */
+	char path[PATH_MAX];
+};
+
+static pthread_once_t temps_once = PTHREAD_ONCE_INIT;
+static struct temp_input *temps;
+static unsigned int nb_temps;
+
+struct sensors {
+	struct cpu_topo topo;
+	int msr_fd;
+	uint64_t aperf;
+	uint64_t mperf;
+	unsigned int base_mhz;
+};
+
+static int read_line(char const * const path, char * const buf, const size_t size)
+{
+	FILE *f;
+	int r = -1;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	if (fgets(buf, size, f)) {
+		buf[strcspn(buf, "\n")] = '\0';
+		r = 0;
+	}
+	fclose(f);
+
+	return r;
+}
+
+static long long int read_ll(char const * const path, const long long int dflt)
+{
+	char buf[32], *end;
+	long long int res;
+
+	if (read_line(path, buf, sizeof(buf)))
+		return dflt;
+	res = strtoll(buf, &end, 10);
+
+	return end == buf ? dflt : res;
+}
+
+static void add_temp(const int package, const int core, char const * const dir, char const * const file)
+{
+	struct temp_input *tmp;
+
+	tmp = realloc(temps, sizeof(*temps)*(nb_temps+1));
+	if (!tmp)
+		return;
+	temps = tmp;
+	temps[nb_temps].package = package;
+	temps[nb_temps].core = core;
+	snprintf(temps[nb_temps].path, sizeof(temps[nb_temps].path), "%s/%s", dir, file);
+	nb_temps++;
+}
+
+/* Calls fn for each tempN_label of dir, with the matching tempN_input */
+static void for_each_label(char const * const dir, void (*fn)(void *ctx, char const *label, char const *dir, char const *input), void * const ctx)
+{
+	char path[PATH_MAX], label[64], input[32];
+	struct dirent *de;
+	unsigned int n;
+	int len;
+	DIR *d;
+
+	d = opendir(dir);
+	if (!d)
+		return;
+	while ((de = readdir(d))) {
+		len = 0;
+		if (sscanf(de->d_name, "temp%u_label%n", &n, &len) != 1 || de->d_name[len])
+			continue;
+		snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+		snprintf(input, sizeof(input), "temp%u_input", n);
+		if (!read_line(path, label, sizeof(label)))
+			fn(ctx, label, dir, input);
+	}
+	closedir(d);
+}
+
+static void coretemp_package(void *ctx, char const *label, char const *dir, char const *input)
+{
+	sscanf(label, "Package id %d", (int*)ctx);
+}
+
+static void coretemp_inputs(void *ctx, char const *label, char const *dir, char const *input)
+{
+	const int package = *(int*)ctx;
+	int core;
+
+	if (sscanf(label, "Core %d", &core) == 1)
+		add_temp(package, core, dir, input);
+	else if (!strncmp(label, "Package id", 10))
+		add_temp(package, -1, dir, input);
+}
+
+static void amd_inputs(void *ctx, char const *label, char const *dir, char const *input)
+{
+	if (!strcmp(label, "Tctl") || !strcmp(label, "Tdie"))
+		add_temp(*(int*)ctx, -1, dir, input);
+}
+
+/* Packages without a Package id label are numbered in directory order */
+static void scan_temps(void)
+{
+	char dir[320], path[PATH_MAX], name[32];
+	struct dirent *de;
+	int package, next_package = 0, zone;
+	DIR *d;
+
+	d = opendir(SYSFS_HWMON);
+	if (d) {
+		while ((de = readdir(d))) {
+			if (strncmp(de->d_name, "hwmon", 5))
+				continue;
+			snprintf(dir, sizeof(dir), SYSFS_HWMON "/%s", de->d_name);
+			snprintf(path, sizeof(path), "%s/name", dir);
+			if (read_line(path, name, sizeof(name)))
+				continue;
+			package = -1;
+			if (!strcmp(name, "coretemp")) {
+				for_each_label(dir, coretemp_package, &package);
+				if (package == -1)
+					package = next_package;
+				for_each_label(dir, coretemp_inputs, &package);
+			} else if (!strcmp(name, "k10temp") || !strcmp(name, "zenpower")) {
+				package = next_package;
+				for_each_label(dir, amd_inputs, &package);
+			} else
+				continue;
+			if (package >= next_package)
+				next_package = package+1;
+		}
+		closedir(d);
+	}
+
+	if (nb_temps)
+		return;
+
+	for (zone=0, package=0 ; ; zone++) {
+		snprintf(dir, sizeof(dir), SYSFS_THERMAL "/thermal_zone%d", zone);
+		snprintf(path, sizeof(path), "%s/type", dir);
+		if (read_line(path, name, sizeof(name)))
+			break;
+		if (!strcmp(name, "x86_pkg_temp"))
+			add_temp(package++, -1, dir, "temp");
+	}
+}
+
+struct sensors * sensors_new(void)
+{
+	struct sensors *sensors;
+
+	pthread_once(&temps_once, scan_temps);
+
+	sensors = malloc(sizeof(*sensors));
+	if (!sensors) {
+		fprintf(stderr, "Could not allocate sensors\n");
+		return NULL;
+	}
+	sensors->topo.cpu = -1;
+	sensors->msr_fd = -1;
+
+	return sensors;
+}
+
+void sensors_delete(struct sensors * const sensors)
+{
+	if (sensors->msr_fd != -1)
+		close(sensors->msr_fd);
+	free(sensors);
+}
+
+static void switch_cpu(struct sensors * const sensors, const int cpu)
+{
+	char path[96];
+
+	if (sensors->msr_fd != -1)
+		close(sensors->msr_fd);
+	snprintf(path, sizeof(path), "/dev/cpu/%d/msr", cpu);
+	sensors->msr_fd = open(path, O_RDONLY);
+	sensors->aperf = sensors->mperf = 0;
+
+	snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cpufreq/base_frequency", cpu);
+	sensors->base_mhz = read_ll(path, 0) / 1000;
+
+	topology_fill(&sensors->topo, cpu);
+}
+
+/* Average effective frequency since the previous sample */
+static uint32_t msr_mhz(struct sensors * const sensors)
+{
+	uint64_t aperf, mperf;
+	uint32_t mhz = 0;
+
+	if (sensors->msr_fd == -1 || !sensors->base_mhz
+			|| pread(sensors->msr_fd, &aperf, sizeof(aperf), MSR_APERF) != sizeof(aperf)
+			|| pread(sensors->msr_fd, &mperf, sizeof(mperf), MSR_MPERF) != sizeof(mperf))
+		return 0;
+
+	if (sensors->mperf && mperf > sensors->mperf)
+		mhz = (double)sensors->base_mhz * (aperf - sensors->aperf) / (mperf - sensors->mperf);
+	sensors->aperf = aperf;
+	sensors->mperf = mperf;
+
+	return mhz;
+}
+
+void sensors_clear(struct sensor_sample * const sample)
+{
+	sample->ns = 0;
+	sample->mhz = 0;
+	sample->core_temp = sample->package_temp = SENSOR_TEMP_UNKNOWN;
+	sample->reserved = 0;
+	sample->core_throttles = sample->package_throttles = SENSOR_COUNT_UNKNOWN;
+}
+
+void sensors_sample(struct sensors * const sensors, int cpu, struct sensor_sample * const sample)
+{
+	struct timespec ts;
+	char path[128];
+	unsigned int i;
+	int package;
+
+	sensors_clear(sample);
+	clock_gettime(CLOCK_REALTIME, &ts);
+	sample->ns = (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+
+	if (cpu == -1)
+		cpu = topology_current_cpu();
+	if (cpu < 0)
+		return;
+	if (cpu != sensors->topo.cpu)
+		switch_cpu(sensors, cpu);
+	package = sensors->topo.package_id == -1 ? 0 : sensors->topo.package_id;
+
+	sample->mhz = msr_mhz(sensors);
+	if (!sample->mhz) {
+		snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cpufreq/scaling_cur_freq", cpu);
+		sample->mhz = read_ll(path, 0) / 1000;
+	}
+
+	for (i=0 ; i<nb_temps ; i++) {
+		if (temps[i].package != package)
+			continue;
+		if (temps[i].core == -1)
+			sample->package_temp = read_ll(temps[i].path, SENSOR_TEMP_UNKNOWN);
+		else if (temps[i].core == sensors->topo.core_id)
+			sample->core_temp = read_ll(temps[i].path, SENSOR_TEMP_UNKNOWN);
+	}
+
+	snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/thermal_throttle/core_throttle_count", cpu);
+	sample->core_throttles = read_ll(path, SENSOR_COUNT_UNKNOWN);
+	snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/thermal_throttle/package_throttle_count", cpu);
+	sample->package_throttles = read_ll(path, SENSOR_COUNT_UNKNOWN);
+}
+
+void sensors_print(FILE *out, struct sensor_sample const * const sample)
+{
+	struct timespec ts;
+	char const *sep = " ";
+	uint64_t now;
+
+	if (!sample->ns) {
+		fprintf(out, "Machine context: not sampled yet\n");
+		return;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	now = (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+
+	fprintf(out, "Machine context, sampled %.1fs ago:", now > sample->ns ? (now - sample->ns)/1e9 : 0.);
+	if (sample->mhz) {
+		fprintf(out, "%s%u MHz", sep, sample->mhz);
+		sep = ", ";
+	}
+	if (sample->core_temp != SENSOR_TEMP_UNKNOWN) {
+		fprintf(out, "%score %.1fC", sep, sample->core_temp/1000.);
+		sep = ", ";
+	}
+	if (sample->package_temp != SENSOR_TEMP_UNKNOWN) {
+		fprintf(out, "%spackage %.1fC", sep, sample->package_temp/1000.);
+		sep = ", ";
+	}
+	if (sample->core_throttles != SENSOR_COUNT_UNKNOWN) {
+		fprintf(out, "%s%llu core throttles", sep, (unsigned long long int)sample->core_throttles);
+		sep = ", ";
+	}
+	if (sample->package_throttles != SENSOR_COUNT_UNKNOWN) {
+		fprintf(out, "%s%llu package throttles", sep, (unsigned long long int)sample->package_throttles);
+		sep = ", ";
+	}
+	fprintf(out, "%s\n", sep[0] == ' ' ? " nothing available" : "");
+}
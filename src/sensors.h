@@ -0,0 +1,52 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#ifndef SENSORS_H
+#define SENSORS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define SENSOR_TEMP_UNKNOWN INT32_MIN
+#define SENSOR_COUNT_UNKNOWN UINT64_MAX
+
+/* Machine context of a cpu, also the layout published in statistics pages */
+struct sensor_sample {
+	uint64_t ns;		/* CLOCK_REALTIME, 0 if never sampled */
+	uint32_t mhz;		/* Effective frequency, 0 if unknown */
+	int32_t core_temp;	/* Millidegrees Celsius */
+	int32_t package_temp;
+	uint32_t reserved;
+	uint64_t core_throttles;
+	uint64_t package_throttles;
+};
+
+/* Per thread sampler. Frequencies come from APERF/MPERF deltas between two
+ * samples of the same cpu when /dev/cpu/N/msr is readable, from cpufreq
+ * otherwise; temperatures from coretemp/k10temp hwmon or thermal zones;
+ * throttle counts from thermal_throttle. */
+struct sensors;
+
+struct sensors * sensors_new(void);
+void sensors_delete(struct sensors * const sensors);
+/* Marks everything as unknown and never sampled */
+void sensors_clear(struct sensor_sample * const sample);
+/* Samples cpu, or the calling thread's cpu if -1 */
+void sensors_sample(struct sensors * const sensors, int cpu, struct sensor_sample * const sample);
+/* Prints a one line summary */
+void sensors_print(FILE *out, struct sensor_sample const * const sample);
+
+#endif
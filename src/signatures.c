@@ -0,0 +1,239 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "signatures.h"
+
+/* Distinct signatures tracked, others are only counted */
+#define SIGNATURES_MAX 256
+/* Signatures and bits per signature printed in summaries */
+#define SIGNATURES_SHOWN 10
+#define BITS_SHOWN 4
+
+/* Inconsistencies with no differing output described have a NULL output */
+struct signature {
+	char const *checker;
+	int cpu;
+	char const *output;
+	unsigned int word;
+	/* Whether the output spans several words */
+	int multiword;
+	unsigned long int count;
+	unsigned long int flips[64];
+};
+
+struct signatures {
+	pthread_mutex_t lock;
+	struct signature *sigs;
+	unsigned int nb_sigs;
+	unsigned long int untracked;
+	unsigned long int inconsistencies;
+	unsigned long int summarised;
+};
+
+/* Inconsistency being added */
+struct add_ctx {
+	struct signatures *sigs;
+	char const *checker;
+	int cpu;
+};
+
+struct signatures * signatures_new(void)
+{
+	struct signatures *sigs;
+
+	sigs = malloc(sizeof(*sigs));
+	if (!sigs) {
+		fprintf(stderr, "Could not allocate signatures\n");
+		return NULL;
+	}
+	if (pthread_mutex_init(&sigs->lock, NULL)) {
+		fprintf(stderr, "Could not allocate signatures mutex\n");
+		free(sigs);
+		return NULL;
+	}
+	sigs->sigs = malloc(sizeof(*sigs->sigs)*SIGNATURES_MAX);
+	if (!sigs->sigs) {
+		fprintf(stderr, "Could not allocate signatures\n");
+		pthread_mutex_destroy(&sigs->lock);
+		free(sigs);
+		return NULL;
+	}
+	sigs->nb_sigs = 0;
+	sigs->untracked = 0;
+	sigs->inconsistencies = 0;
+	sigs->summarised = 0;
+
+	return sigs;
+}
+
+void signatures_delete(struct signatures * const sigs)
+{
+	free(sigs->sigs);
+	pthread_mutex_destroy(&sigs->lock);
+	free(sigs);
+}
+
+static struct signature * find(struct add_ctx const * const ctx, char const * const output, const unsigned int word)
+{
+	struct signatures * const sigs = ctx->sigs;
+	struct signature *sig;
+	unsigned int i;
+
+	for (i=0 ; i<sigs->nb_sigs ; i++) {
+		sig = &sigs->sigs[i];
+		if (sig->checker == ctx->checker && sig->cpu == ctx->cpu && sig->output == output && sig->word == word)
+			return sig;
+	}
+
+	if (sigs->nb_sigs == SIGNATURES_MAX) {
+		sigs->untracked++;
+		return NULL;
+	}
+
+	sig = &sigs->sigs[sigs->nb_sigs++];
+	memset(sig, 0, sizeof(*sig));
+	sig->checker = ctx->checker;
+	sig->cpu = ctx->cpu;
+	sig->output = output;
+	sig->word = word;
+
+	return sig;
+}
+
+static void add_output(void * const arg, struct cpucheck_output const * const output,
+		void const * const expected, void const * const got)
+{
+	struct add_ctx const * const ctx = arg;
+	struct signature *sig;
+	uint64_t e, g, flipped;
+	size_t off, len;
+	unsigned int bit;
+
+	for (off=0 ; off<output->size ; off+=8) {
+		len = output->size-off < 8 ? output->size-off : 8;
+		e = g = 0;
+		memcpy(&e, (char const*)expected+off, len);
+		memcpy(&g, (char const*)got+off, len);
+		flipped = e ^ g;
+		if (!flipped)
+			continue;
+
+		sig = find(ctx, output->name, off/8);
+		if (!sig)
+			continue;
+		sig->multiword = output->size > 8;
+		sig->count++;
+		for (bit=0 ; bit<64 ; bit++)
+			if (flipped & 1ULL<<bit)
+				sig->flips[bit]++;
+	}
+}
+
+void signatures_add(struct signatures * const sigs, struct cpucheck_table const * const table,
+		void const * const table_element, void const * const comp, const int cpu)
+{
+	struct add_ctx ctx = { .sigs = sigs, .checker = cpucheck_table_checker(table)->name, .cpu = cpu };
+	struct signature *sig;
+
+	pthread_mutex_lock(&sigs->lock);
+	sigs->inconsistencies++;
+	if (cpucheck_diff(table, table_element, comp, add_output, &ctx) <= 0 && (sig = find(&ctx, NULL, 0)))
+		sig->count++;
+	pthread_mutex_unlock(&sigs->lock);
+}
+
+static int cmp_count(void const * const a, void const * const b)
+{
+	struct signature const * const sa = *(struct signature const * const *)a;
+	struct signature const * const sb = *(struct signature const * const *)b;
+
+	return sa->count < sb->count ? 1 : sa->count > sb->count ? -1 : 0;
+}
+
+static void print_signature(FILE *out, struct signature const * const sig)
+{
+	unsigned int shown[BITS_SHOWN];
+	unsigned int n, i, bit;
+
+	fprintf(out, "\tcpu %d, %s ", sig->cpu, sig->checker);
+	if (!sig->output) {
+		fprintf(out, "(no described output differs): %lu times\n", sig->count);
+		return;
+	}
+	if (sig->multiword)
+		fprintf(out, "%s[%u]", sig->output, sig->word);
+	else
+		fprintf(out, "%s", sig->output);
+	fprintf(out, ": %lu times, bits", sig->count);
+
+	/* Most flipped bits first */
+	for (n=0 ; n<BITS_SHOWN ; n++) {
+		for (bit=0, shown[n]=64 ; bit<64 ; bit++) {
+			for (i=0 ; i<n && shown[i] != bit ; i++) ;
+			if (i == n && sig->flips[bit] && (shown[n] == 64 || sig->flips[bit] > sig->flips[shown[n]]))
+				shown[n] = bit;
+		}
+		if (shown[n] == 64)
+			break;
+		fprintf(out, "%s %u (%lu)", n ? "," : "", shown[n], sig->flips[shown[n]]);
+	}
+	fprintf(out, "\n");
+}
+
+static void print_summary(struct signatures * const sigs, FILE *out)
+{
+	struct signature **sorted;
+	unsigned int i;
+
+	if (sigs->summarised == sigs->inconsistencies)
+		return;
+
+	fprintf(out, "Error signatures of %lu inconsistencies, %lu since the previous summary:\n",
+			sigs->inconsistencies, sigs->inconsistencies - sigs->summarised);
+	sigs->summarised = sigs->inconsistencies;
+
+	sorted = malloc(sizeof(*sorted)*sigs->nb_sigs);
+	if (!sorted) {
+		fprintf(out, "\t(could not allocate summary)\n");
+		return;
+	}
+	for (i=0 ; i<sigs->nb_sigs ; i++)
+		sorted[i] = &sigs->sigs[i];
+	qsort(sorted, sigs->nb_sigs, sizeof(*sorted), cmp_count);
+
+	for (i=0 ; i<sigs->nb_sigs && i<SIGNATURES_SHOWN ; i++)
+		print_signature(out, sorted[i]);
+	if (sigs->nb_sigs > SIGNATURES_SHOWN)
+		fprintf(out, "\t%u less frequent signatures not shown\n", sigs->nb_sigs - SIGNATURES_SHOWN);
+	if (sigs->untracked)
+		fprintf(out, "\t%lu words differed past the %u tracked signatures\n", sigs->untracked, SIGNATURES_MAX);
+
+	free(sorted);
+}
+
+void signatures_print(struct signatures * const sigs, FILE *out)
+{
+	pthread_mutex_lock(&sigs->lock);
+	print_summary(sigs, out);
+	pthread_mutex_unlock(&sigs->lock);
+}
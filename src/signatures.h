@@ -0,0 +1,38 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+
+#ifndef SIGNATURES_H
+#define SIGNATURES_H
+
+#include <stdio.h>
+#include "libcpucheck.h"
+
+struct signatures;
+
+/* Aggregates inconsistencies by checker, cpu and differing output, split in
+ * 64 bits words, with a histogram of the positions of flipped bits within
+ * each word. Inconsistencies may be added from any thread. */
+struct signatures * signatures_new(void);
+void signatures_delete(struct signatures * const sigs);
+/* cpu may be -1 if unknown */
+void signatures_add(struct signatures * const sigs, struct cpucheck_table const * const table,
+		void const * const table_element, void const * const comp, const int cpu);
+/* Prints the most frequent signatures if inconsistencies were added since the
+ * previous summary */
+void signatures_print(struct signatures * const sigs, FILE *out);
+
+#endif
@@ -0,0 +1,262 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "libcpucheck.h"
+#include "smt.h"
+
+/* Checks between two looks at the phase */
+#define SMT_BATCH 4096
+#define IDLE_POLL_NS 1000000
+
+enum phase {
+	PHASE_FIRST,
+	PHASE_SECOND,
+	PHASE_BOTH,
+	PHASE_COUNT,
+	PHASE_DONE = PHASE_COUNT,
+	PHASE_WAIT,
+};
+
+/* Checkers stressing different execution units, the first available pairs
+ * are handed out to cores round-robin */
+static char const * const complementary[][2] = {
+	{ "muldiv", "cmps" },
+	{ "cmpxchg", "bool" },
+	{ "lzcnt", "addsub" },
+	{ "bitscan", "signextend" },
+	{ "lea", "bittest" },
+	{ "muldiv", "bool" },
+};
+
+struct smt_state {
+	int phase;
+	pthread_mutex_t output;
+	struct cpucheck_table **tables;
+	unsigned int nb_tables;
+};
+
+struct sibling {
+	pthread_t thread;
+	struct smt_state *smt;
+	int cpu;
+	unsigned int core;
+	unsigned int role;
+	struct cpucheck_worker *worker;
+	unsigned long int checks[PHASE_COUNT];
+	unsigned long int errors;
+	int pin_failed;
+};
+
+static void on_error(void * const ctx, struct cpucheck_worker const * const worker,
+		void const * const table_element, void const * const comp)
+{
+	struct sibling * const s = ctx;
+
+	s->errors++;
+	pthread_mutex_lock(&s->smt->output);
+	cpucheck_report_error(stderr, worker, table_element, comp);
+	fprintf(stderr, "On cpu %d, sibling %u of core %u\n", s->cpu, s->role, s->core);
+	pthread_mutex_unlock(&s->smt->output);
+}
+
+/* Siblings run in their own phase and the paired one, and sleep otherwise
+ * so that the other sibling has the core for itself */
+static void * sibling_func(void *arg)
+{
+	struct sibling * const s = arg;
+	struct timespec idle = { .tv_sec = 0, .tv_nsec = IDLE_POLL_NS };
+	int phase;
+
+	s->pin_failed = !!pin_thread(pthread_self(), s->cpu);
+
+	while ((phase = __atomic_load_n(&s->smt->phase, __ATOMIC_ACQUIRE)) != PHASE_DONE) {
+		if (phase == PHASE_BOTH || phase == (int)s->role) {
+			cpucheck_worker_step(s->worker, SMT_BATCH);
+			s->checks[phase] += SMT_BATCH;
+		} else
+			nanosleep(&idle, NULL);
+	}
+
+	return NULL;
+}
+
+static uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+/* Tables are shared by every sibling running the same checker */
+static struct cpucheck_table * get_table(struct smt_state * const smt, struct cpucheck_checker const * const checker,
+		const size_t table_size)
+{
+	struct cpucheck_table *table, **tables;
+	unsigned int i;
+
+	for (i=0 ; i<smt->nb_tables ; i++)
+		if (cpucheck_table_checker(smt->tables[i]) == checker)
+			return smt->tables[i];
+
+	tables = realloc(smt->tables, sizeof(*smt->tables)*(smt->nb_tables+1));
+	if (!tables) {
+		fprintf(stderr, "Could not allocate tables\n");
+		return NULL;
+	}
+	smt->tables = tables;
+
+	table = cpucheck_table_new(checker, table_size);
+	if (table)
+		smt->tables[smt->nb_tables++] = table;
+
+	return table;
+}
+
+static void print_results(FILE *out, struct sibling const * const siblings, const unsigned int nb_siblings,
+		double const * const elapsed)
+{
+	unsigned int i;
+
+	fprintf(out, "core,cpu,checker,solo_checks_per_s,paired_checks_per_s,drop_percent,inconsistencies\n");
+	for (i=0 ; i<nb_siblings ; i++) {
+		struct sibling const * const s = &siblings[i];
+		const double solo = s->checks[s->role] / elapsed[s->role];
+		const double paired = s->checks[PHASE_BOTH] / elapsed[PHASE_BOTH];
+
+		fprintf(out, "%u,%d,%s,%.0f,%.0f,%.1f,%lu\n", s->core, s->cpu,
+				cpucheck_table_checker(cpucheck_worker_table(s->worker))->name,
+				solo, paired, solo ? 100*(1-paired/solo) : 0., s->errors);
+	}
+}
+
+long int smt_run(FILE *out, struct cpu_topo const * const cpus, const unsigned int count,
+		const size_t table_size, const unsigned int phase_seconds, volatile int const * const should_stop)
+{
+	struct smt_state smt = { .phase = PHASE_WAIT, .tables = NULL, .nb_tables = 0 };
+	struct timespec tick = { .tv_sec = 0, .tv_nsec = 100000000 };
+	unsigned int avail[sizeof(complementary)/sizeof(complementary[0])];
+	unsigned int i, j, role, nb_avail = 0, nb_siblings = 0, started = 0, pin_failed = 0;
+	double elapsed[PHASE_COUNT];
+	struct sibling *siblings;
+	char *used;
+	uint64_t start;
+	long int r = -1;
+	int phase = PHASE_WAIT;
+
+	for (i=0 ; i<sizeof(complementary)/sizeof(complementary[0]) ; i++)
+		if (cpucheck_find_checker(complementary[i][0]) && cpucheck_find_checker(complementary[i][1]))
+			avail[nb_avail++] = i;
+	if (!nb_avail) {
+		fprintf(stderr, "No complementary checkers available\n");
+		return -1;
+	}
+
+	siblings = calloc(count, sizeof(*siblings));
+	used = calloc(count, 1);
+	if (!siblings || !used) {
+		fprintf(stderr, "Could not allocate siblings\n");
+		goto err_alloc;
+	}
+
+	if (pthread_mutex_init(&smt.output, NULL)) {
+		fprintf(stderr, "Could not allocate output mutex\n");
+		goto err_alloc;
+	}
+
+	for (i=0 ; i<count ; i++) {
+		for (j=i+1 ; j<count && (used[i] || used[j] || !topology_same_core(&cpus[i], &cpus[j])) ; j++) ;
+		if (used[i] || j == count)
+			continue;
+		used[i] = used[j] = 1;
+		siblings[nb_siblings].cpu = cpus[i].cpu;
+		siblings[nb_siblings+1].cpu = cpus[j].cpu;
+		for (role=0 ; role<2 ; role++) {
+			struct sibling * const s = &siblings[nb_siblings+role];
+			struct cpucheck_table *table;
+
+			s->smt = &smt;
+			s->core = nb_siblings/2;
+			s->role = role;
+			table = get_table(&smt, cpucheck_find_checker(complementary[avail[s->core%nb_avail]][role]), table_size);
+			if (!table)
+				goto err_workers;
+			s->worker = cpucheck_worker_new(table, random(), on_error, s);
+			if (!s->worker)
+				goto err_workers;
+		}
+		nb_siblings += 2;
+	}
+	if (!nb_siblings) {
+		fprintf(stderr, "No SMT siblings found\n");
+		goto err_workers;
+	}
+
+	for (started=0 ; started<nb_siblings ; started++) {
+		if (pthread_create(&siblings[started].thread, NULL, sibling_func, &siblings[started])) {
+			fprintf(stderr, "Issue when spawning thread\n");
+			goto err_threads;
+		}
+	}
+
+	for (phase=0 ; phase<PHASE_COUNT && !*should_stop ; phase++) {
+		start = monotonic_ns();
+		__atomic_store_n(&smt.phase, phase, __ATOMIC_RELEASE);
+		for (i=0 ; i<phase_seconds*10 && !*should_stop ; i++)
+			nanosleep(&tick, NULL);
+		elapsed[phase] = (monotonic_ns() - start) / 1e9;
+	}
+
+	r = 0;
+
+err_threads:
+	__atomic_store_n(&smt.phase, PHASE_DONE, __ATOMIC_RELEASE);
+	for (i=0 ; i<started ; i++) {
+		pthread_join(siblings[i].thread, NULL);
+		pin_failed |= siblings[i].pin_failed;
+	}
+
+	if (!r) {
+		if (pin_failed)
+			fprintf(stderr, "Could not pin every sibling, throughputs are meaningless\n");
+		if (phase == PHASE_COUNT)
+			print_results(out, siblings, nb_siblings, elapsed);
+		else
+			fprintf(stderr, "Interrupted before every phase ran\n");
+		for (i=0 ; i<nb_siblings ; i++)
+			r += siblings[i].errors;
+	}
+
+err_workers:
+	for (i=0 ; i<count ; i++)
+		if (siblings[i].worker)
+			cpucheck_worker_delete(siblings[i].worker);
+	for (i=0 ; i<smt.nb_tables ; i++)
+		cpucheck_table_delete(smt.tables[i]);
+	free(smt.tables);
+	pthread_mutex_destroy(&smt.output);
+err_alloc:
+	free(used);
+	free(siblings);
+
+	return r;
+}
@@ -0,0 +1,32 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#ifndef SMT_H
+#define SMT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "topology.h"
+
+/* Pairs the first two SMT siblings of each physical core and gives them
+ * complementary checkers. Runs the first siblings alone, then the second
+ * ones alone, then both for phase_seconds each, and prints per-sibling
+ * throughput, its drop when paired, and inconsistencies as CSV on out.
+ * Returns the number of inconsistencies, or -1 on error. */
+long int smt_run(FILE *out, struct cpu_topo const * const cpus, const unsigned int count,
+		const size_t table_size, const unsigned int phase_seconds, volatile int const * const should_stop);
+
+#endif
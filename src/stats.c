@@ -0,0 +1,113 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "stats.h"
+
+static size_t page_size(const unsigned int capacity)
+{
+	return sizeof(struct stats_page) + capacity*sizeof(struct stats_thread);
+}
+
+uint64_t stats_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+struct stats_page * stats_create(char const * const name, const unsigned int capacity,
+		const unsigned long int table_size, char const * const checker)
+{
+	struct stats_page *page;
+	const size_t size = page_size(capacity);
+	unsigned int i;
+	int fd;
+
+	if (STATS_IS_SHM(name))
+		fd = shm_open(name, O_RDWR|O_CREAT|O_TRUNC, 0644);
+	else
+		fd = open(name, O_RDWR|O_CREAT|O_TRUNC, 0644);
+	if (fd == -1) {
+		fprintf(stderr, "Could not create statistics page %s\n", name);
+		return NULL;
+	}
+
+	if (ftruncate(fd, size)) {
+		fprintf(stderr, "Could not size statistics page %s\n", name);
+		close(fd);
+		return NULL;
+	}
+
+	page = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (page == MAP_FAILED) {
+		fprintf(stderr, "Could not map statistics page %s\n", name);
+		return NULL;
+	}
+
+	page->version = STATS_VERSION;
+	page->thread_size = sizeof(struct stats_thread);
+	page->pid = getpid();
+	page->start_ns = stats_now_ns();
+	page->table_size = table_size;
+	page->capacity = capacity;
+	page->nb_threads = 0;
+	strncpy(page->checker, checker, sizeof(page->checker)-1);
+	for (i=0 ; i<capacity ; i++)
+		page->threads[i].cpu = -1;
+	/* Readers ignore the page until magic shows up */
+	__atomic_store_n(&page->magic, STATS_MAGIC, __ATOMIC_RELEASE);
+
+	return page;
+}
+
+void stats_destroy(struct stats_page * const page, char const * const name)
+{
+	munmap(page, page_size(page->capacity));
+	if (STATS_IS_SHM(name))
+		shm_unlink(name);
+	else
+		unlink(name);
+}
+
+void stats_publish(struct stats_thread * const slot, const int cpu, const unsigned long int checks,
+		const unsigned long int errors, const uint64_t last_error_ns, char const * const checker,
+		struct sensor_sample const * const sensors)
+{
+	const uint32_t seq = slot->seq;
+
+	__atomic_store_n(&slot->seq, seq+1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&slot->cpu, cpu, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->checks, checks, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->errors, errors, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->last_error_ns, last_error_ns, __ATOMIC_RELAXED);
+	if (strncmp(slot->checker, checker, sizeof(slot->checker)-1))
+		strncpy(slot->checker, checker, sizeof(slot->checker)-1);
+	if (sensors)
+		memcpy(&slot->sensors, sensors, sizeof(slot->sensors));
+	__atomic_store_n(&slot->seq, seq+2, __ATOMIC_RELEASE);
+}
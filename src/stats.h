@@ -0,0 +1,105 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <string.h>
+#include "sensors.h"
+
+/* Layout of the statistics page published with -S. Readers must check
+ * magic and version, and use thread_size to index threads so that fields
+ * appended in later versions do not break them.
+ *
+ * Each thread slot is guarded by a seqlock: seq is odd while the slot is
+ * being updated, a consistent snapshot is one read between two identical
+ * even seq values. */
+
+#define STATS_MAGIC 0x53544b4843555043ULL	/* "CPUCHKTS" */
+#define STATS_VERSION 2
+#define STATS_NAME_SIZE 32
+
+struct stats_thread {
+	uint32_t seq;
+	int32_t cpu;
+	uint64_t checks;
+	uint64_t errors;
+	uint64_t last_error_ns;	/* CLOCK_REALTIME, 0 if no error yet */
+	char checker[STATS_NAME_SIZE];
+	/* Version 2 */
+	struct sensor_sample sensors;
+} __attribute__((aligned(64)));
+
+struct stats_page {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t thread_size;
+	int64_t pid;
+	uint64_t start_ns;	/* CLOCK_REALTIME */
+	uint64_t table_size;
+	uint32_t capacity;
+	uint32_t nb_threads;
+	char checker[STATS_NAME_SIZE];
+	struct stats_thread threads[];
+};
+
+/* Names with a single leading slash are POSIX shared memory objects, other
+ * ones are regular files */
+#define STATS_IS_SHM(name) ((name)[0] == '/' && !strchr((name)+1, '/'))
+
+/* Consistent copy of a thread slot of a page of the given version, returns
+ * 0 on success, non-zero if the writer kept the slot busy */
+static inline int stats_read_thread(struct stats_thread * const dst, struct stats_thread const * const src,
+		const uint32_t version)
+{
+	unsigned int tries;
+	uint32_t seq;
+
+	for (tries=0 ; tries<1000 ; tries++) {
+		seq = __atomic_load_n(&src->seq, __ATOMIC_ACQUIRE);
+		if (seq%2)
+			continue;
+		dst->cpu = __atomic_load_n(&src->cpu, __ATOMIC_RELAXED);
+		dst->checks = __atomic_load_n(&src->checks, __ATOMIC_RELAXED);
+		dst->errors = __atomic_load_n(&src->errors, __ATOMIC_RELAXED);
+		dst->last_error_ns = __atomic_load_n(&src->last_error_ns, __ATOMIC_RELAXED);
+		__builtin_memcpy(dst->checker, (char const *)src->checker, sizeof(dst->checker));
+		if (version >= 2)
+			__builtin_memcpy(&dst->sensors, (char const *)&src->sensors, sizeof(dst->sensors));
+		else
+			__builtin_memset(&dst->sensors, 0, sizeof(dst->sensors));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&src->seq, __ATOMIC_RELAXED) == seq) {
+			dst->seq = seq;
+			dst->checker[sizeof(dst->checker)-1] = '\0';
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+/* Writer side */
+struct stats_page * stats_create(char const * const name, const unsigned int capacity,
+		const unsigned long int table_size, char const * const checker);
+void stats_destroy(struct stats_page * const page, char const * const name);
+void stats_publish(struct stats_thread * const slot, const int cpu, const unsigned long int checks,
+		const unsigned long int errors, const uint64_t last_error_ns, char const * const checker,
+		struct sensor_sample const * const sensors);
+uint64_t stats_now_ns(void);
+
+#endif
@@ -0,0 +1,217 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "sweep.h"
+
+/* Checks between two looks at the phase */
+#define SWEEP_BATCH 4096
+
+#define min(a, b) ((a)<(b)?(a):(b))
+
+enum phase {
+	PHASE_WAIT,
+	PHASE_RUN,
+	PHASE_DONE,
+};
+
+struct sweep_state {
+	int phase;
+	pthread_mutex_t output;
+};
+
+struct sweeper {
+	pthread_t thread;
+	struct sweep_state *sweep;
+	int cpu;
+	struct cpucheck_worker *worker;
+	unsigned long int checks;
+	unsigned long int errors;
+	int pin_failed;
+};
+
+static void on_error(void * const ctx, struct cpucheck_worker const * const worker,
+		void const * const table_element, void const * const comp)
+{
+	struct sweeper * const s = ctx;
+
+	s->errors++;
+	pthread_mutex_lock(&s->sweep->output);
+	cpucheck_report_error(stderr, worker, table_element, comp);
+	fprintf(stderr, "On cpu %d\n", s->cpu);
+	pthread_mutex_unlock(&s->sweep->output);
+}
+
+/* Batches completed once the step is over are not accounted */
+static void * sweeper_func(void *arg)
+{
+	struct sweeper * const s = arg;
+	const unsigned long int start = cpucheck_worker_checks(s->worker);
+	int phase;
+
+	s->pin_failed = !!pin_thread(pthread_self(), s->cpu);
+
+	/* Worker counters account for repeated checks */
+	while ((phase = __atomic_load_n(&s->sweep->phase, __ATOMIC_ACQUIRE)) != PHASE_DONE) {
+		if (phase == PHASE_WAIT) {
+			sched_yield();
+			continue;
+		}
+		cpucheck_worker_step(s->worker, SWEEP_BATCH);
+		if (__atomic_load_n(&s->sweep->phase, __ATOMIC_RELAXED) == PHASE_RUN)
+			s->checks = cpucheck_worker_checks(s->worker) - start;
+	}
+
+	return NULL;
+}
+
+static uint64_t monotonic_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+/* Runs nb_threads sweepers for step_seconds, returns the elapsed time in
+ * seconds, 0 if interrupted, or -1 on error */
+static double run_step(struct sweep_state * const sweep, struct sweeper * const sweepers, const unsigned int nb_threads,
+		const unsigned int step_seconds, volatile int const * const should_stop)
+{
+	struct timespec tick = { .tv_sec = 0, .tv_nsec = 100000000 };
+	unsigned int i, started;
+	double elapsed = -1;
+	uint64_t start;
+
+	__atomic_store_n(&sweep->phase, PHASE_WAIT, __ATOMIC_RELEASE);
+	for (started=0 ; started<nb_threads ; started++) {
+		if (pthread_create(&sweepers[started].thread, NULL, sweeper_func, &sweepers[started])) {
+			fprintf(stderr, "Issue when spawning thread\n");
+			goto err_threads;
+		}
+	}
+
+	start = monotonic_ns();
+	__atomic_store_n(&sweep->phase, PHASE_RUN, __ATOMIC_RELEASE);
+	for (i=0 ; i<step_seconds*10 && !*should_stop ; i++)
+		nanosleep(&tick, NULL);
+	elapsed = *should_stop ? 0 : (monotonic_ns() - start) / 1e9;
+
+err_threads:
+	__atomic_store_n(&sweep->phase, PHASE_DONE, __ATOMIC_RELEASE);
+	for (i=0 ; i<started ; i++)
+		pthread_join(sweepers[i].thread, NULL);
+
+	return elapsed;
+}
+
+long int sweep_run(FILE *out, struct cpu_topo * const cpus, const unsigned int count,
+		struct cpucheck_table const * const table, const unsigned int repeat, const size_t prefetch,
+		const unsigned int step_seconds, volatile int const * const should_stop)
+{
+	struct sweep_state sweep = { .phase = PHASE_WAIT };
+	struct sweeper *sweepers;
+	unsigned int i, nb_threads, added = 0;
+	double elapsed, rate, base = 0;
+	unsigned long int checks, errors;
+	long int r = -1, total = 0;
+	int pin_failed;
+
+	if (topology_spread_order(cpus, count)) {
+		fprintf(stderr, "Could not order cpus\n");
+		return -1;
+	}
+
+	sweepers = calloc(count, sizeof(*sweepers));
+	if (!sweepers) {
+		fprintf(stderr, "Could not allocate sweepers\n");
+		return -1;
+	}
+
+	if (pthread_mutex_init(&sweep.output, NULL)) {
+		fprintf(stderr, "Could not allocate output mutex\n");
+		goto err_alloc;
+	}
+
+	for (i=0 ; i<count ; i++) {
+		sweepers[i].sweep = &sweep;
+		sweepers[i].cpu = cpus[i].cpu;
+		sweepers[i].worker = cpucheck_worker_new(table, random(), on_error, &sweepers[i]);
+		if (!sweepers[i].worker)
+			goto err_workers;
+		cpucheck_worker_set_repeat(sweepers[i].worker, repeat);
+		if (prefetch)
+			cpucheck_worker_set_prefetch(sweepers[i].worker, prefetch);
+	}
+
+	fprintf(out, "threads,added_cpus,checks_per_s,per_thread_checks_per_s,efficiency_percent,inconsistencies\n");
+	fflush(out);
+
+	for (nb_threads=1 ; !*should_stop ; nb_threads=min(nb_threads*2, count)) {
+		for (i=0 ; i<nb_threads ; i++)
+			sweepers[i].checks = sweepers[i].errors = 0;
+
+		elapsed = run_step(&sweep, sweepers, nb_threads, step_seconds, should_stop);
+		if (elapsed < 0)
+			goto err_workers;
+
+		checks = errors = 0;
+		pin_failed = 0;
+		for (i=0 ; i<nb_threads ; i++) {
+			checks += sweepers[i].checks;
+			errors += sweepers[i].errors;
+			pin_failed |= sweepers[i].pin_failed;
+		}
+		total += errors;
+		if (!elapsed)
+			break;
+		if (pin_failed)
+			fprintf(stderr, "Could not pin every thread, throughput of %u threads is meaningless\n", nb_threads);
+
+		rate = checks / elapsed;
+		if (nb_threads == 1)
+			base = rate;
+
+		fprintf(out, "%u,", nb_threads);
+		for (i=added ; i<nb_threads ; i++)
+			fprintf(out, "%s%d", i == added ? "" : " ", cpus[i].cpu);
+		added = nb_threads;
+		fprintf(out, ",%.0f,%.0f,%.1f,%lu\n", rate, rate/nb_threads, base ? 100*rate/nb_threads/base : 0., errors);
+		fflush(out);
+
+		if (nb_threads == count)
+			break;
+	}
+
+	r = total;
+
+err_workers:
+	for (i=0 ; i<count ; i++)
+		if (sweepers[i].worker)
+			cpucheck_worker_delete(sweepers[i].worker);
+	pthread_mutex_destroy(&sweep.output);
+err_alloc:
+	free(sweepers);
+
+	return r;
+}
@@ -0,0 +1,37 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "libcpucheck.h"
+#include "topology.h"
+
+/* Checks table with 1, 2, 4, ... and finally count threads, for
+ * step_seconds each. Threads are pinned following topology_spread_order(),
+ * so that the curve shows physical cores first, then SMT siblings, then the
+ * next packages. Prints one CSV line per step on out as soon as it is over:
+ * aggregated and per-thread throughput, efficiency relative to the single
+ * thread step, and inconsistencies. cpus gets reordered.
+ * Returns the number of inconsistencies, or -1 on error. */
+long int sweep_run(FILE *out, struct cpu_topo * const cpus, const unsigned int count,
+		struct cpucheck_table const * const table, const unsigned int repeat, const size_t prefetch,
+		const unsigned int step_seconds, volatile int const * const should_stop);
+
+#endif
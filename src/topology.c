@@ -0,0 +1,277 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#if HAVE_SCHED_H
+#include <sched.h>
+#endif
+#include "topology.h"
+
+#define SYSFS_CPU "/sys/devices/system/cpu"
+/* PMUs of hybrid parts, listing the cpus of each core type */
+#define SYSFS_PCORES "/sys/devices/cpu_core/cpus"
+#define SYSFS_ECORES "/sys/devices/cpu_atom/cpus"
+
+/* Core types in CPUID leaf 0x1A */
+#define CPUID_CORE_TYPE_ATOM 0x20
+#define CPUID_CORE_TYPE_CORE 0x40
+
+static int read_topology_int(const int cpu, char const * const what)
+{
+	char path[128];
+	FILE *f;
+	int res;
+
+	snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/%s", cpu, what);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	if (fscanf(f, "%d", &res) != 1)
+		res = -1;
+	fclose(f);
+
+	return res;
+}
+
+/* Returns 1 if cpu is in the cpu list (as in "0-7,16") read from path, 0 if
+ * not, -1 if path could not be read */
+static int cpulist_contains(char const * const path, const int cpu)
+{
+	FILE *f;
+	int first, last, r = 0;
+	char sep;
+
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	while (!r && fscanf(f, "%d", &first) == 1) {
+		last = first;
+		sep = fgetc(f);
+		if (sep == '-') {
+			if (fscanf(f, "%d", &last) != 1)
+				break;
+			sep = fgetc(f);
+		}
+		r = cpu >= first && cpu <= last;
+		if (sep != ',')
+			break;
+	}
+	fclose(f);
+
+	return r;
+}
+
+void topology_fill(struct cpu_topo * const topo, const int cpu)
+{
+	topo->cpu = cpu;
+	topo->core_id = read_topology_int(cpu, "core_id");
+	topo->package_id = read_topology_int(cpu, "physical_package_id");
+	if (cpulist_contains(SYSFS_PCORES, cpu) == 1)
+		topo->core_type = CORE_TYPE_PERFORMANCE;
+	else if (cpulist_contains(SYSFS_ECORES, cpu) == 1)
+		topo->core_type = CORE_TYPE_EFFICIENCY;
+	else
+		topo->core_type = CORE_TYPE_UNKNOWN;
+}
+
+char const * topology_core_type_name(const int core_type)
+{
+	switch (core_type) {
+		case CORE_TYPE_PERFORMANCE:
+			return "performance";
+		case CORE_TYPE_EFFICIENCY:
+			return "efficiency";
+		default:
+			return "unknown";
+	}
+}
+
+#if ARCH_X86_64 && HAVE_SCHED_GETAFFINITY
+static void cpuid(const uint32_t leaf, uint32_t * const eax, uint32_t * const edx)
+{
+	uint32_t ecx = 0;
+
+	asm volatile("cpuid"
+		: "=a" (*eax), "+c" (ecx), "=d" (*edx)
+		: "a" (leaf)
+		: "ebx"
+	);
+}
+
+/* Runs CPUID leaf 0x1A on each cpu whose type sysfs did not tell, when the
+ * part reports itself as hybrid. The calling thread moves from cpu to cpu and
+ * gets its affinity back. */
+static void fill_core_types(struct cpu_topo * const cpus, const unsigned int count, cpu_set_t const * const allowed)
+{
+	uint32_t eax, edx;
+	unsigned int i;
+	cpu_set_t cs;
+
+	cpuid(0, &eax, &edx);
+	if (eax < 0x1a)
+		return;
+	cpuid(7, &eax, &edx);
+	if (!(edx & 1<<15))
+		return;
+
+	for (i=0 ; i<count ; i++) {
+		if (cpus[i].core_type != CORE_TYPE_UNKNOWN)
+			continue;
+		CPU_ZERO(&cs);
+		CPU_SET(cpus[i].cpu, &cs);
+		if (sched_setaffinity(0, sizeof(cs), &cs))
+			continue;
+		cpuid(0x1a, &eax, &edx);
+		if (eax >> 24 == CPUID_CORE_TYPE_CORE)
+			cpus[i].core_type = CORE_TYPE_PERFORMANCE;
+		else if (eax >> 24 == CPUID_CORE_TYPE_ATOM)
+			cpus[i].core_type = CORE_TYPE_EFFICIENCY;
+	}
+
+	sched_setaffinity(0, sizeof(*allowed), allowed);
+}
+#endif
+
+int topology_get(struct cpu_topo **cpus, unsigned int *count)
+{
+#if HAVE_SCHED_GETAFFINITY
+	cpu_set_t cs;
+	int cpu;
+	unsigned int n;
+
+	memset(&cs, 0, sizeof(cs));
+	if (sched_getaffinity(0, sizeof(cs), &cs))
+		goto fallback;
+
+	*cpus = malloc(sizeof(**cpus) * CPU_COUNT(&cs));
+	if (!*cpus)
+		return -1;
+
+	for (cpu=0, n=0 ; cpu<CPU_SETSIZE ; cpu++)
+		if (CPU_ISSET(cpu, &cs))
+			topology_fill(&(*cpus)[n++], cpu);
+	*count = n;
+#if ARCH_X86_64
+	fill_core_types(*cpus, n, &cs);
+#endif
+
+	return 0;
+
+fallback:
+#endif
+	*cpus = malloc(sizeof(**cpus));
+	if (!*cpus)
+		return -1;
+	topology_fill(*cpus, 0);
+	*count = 1;
+
+	return 0;
+}
+
+int topology_same_core(struct cpu_topo const * const a, struct cpu_topo const * const b)
+{
+	return topology_same_package(a, b)
+		&& a->core_id != -1 && a->core_id == b->core_id;
+}
+
+int topology_same_package(struct cpu_topo const * const a, struct cpu_topo const * const b)
+{
+	return a->package_id != -1 && a->package_id == b->package_id;
+}
+
+struct placement {
+	struct cpu_topo topo;
+	unsigned int package;
+	unsigned int sibling;
+	int core_type;
+	unsigned int index;
+};
+
+static int cmp_placement(void const * const a, void const * const b)
+{
+	struct placement const * const pa = a;
+	struct placement const * const pb = b;
+
+	if (pa->package != pb->package)
+		return pa->package < pb->package ? -1 : 1;
+	if (pa->sibling != pb->sibling)
+		return pa->sibling < pb->sibling ? -1 : 1;
+	/* Unknown types last */
+	if (pa->core_type != pb->core_type)
+		return (unsigned int)pa->core_type < (unsigned int)pb->core_type ? -1 : 1;
+	return pa->index < pb->index ? -1 : pa->index > pb->index;
+}
+
+int topology_spread_order(struct cpu_topo * const cpus, const unsigned int count)
+{
+	struct placement *p;
+	unsigned int i, j;
+
+	p = malloc(sizeof(*p)*count);
+	if (!p)
+		return -1;
+
+	/* Packages are ranked by their first cpu, siblings by their rank in
+	 * their core */
+	for (i=0 ; i<count ; i++) {
+		p[i].topo = cpus[i];
+		p[i].index = i;
+		p[i].package = i;
+		p[i].sibling = 0;
+		p[i].core_type = cpus[i].core_type;
+		for (j=0 ; j<i ; j++) {
+			if (topology_same_package(&cpus[i], &cpus[j]) && p[j].package < p[i].package)
+				p[i].package = p[j].package;
+			if (topology_same_core(&cpus[i], &cpus[j]))
+				p[i].sibling++;
+		}
+	}
+
+	qsort(p, count, sizeof(*p), cmp_placement);
+	for (i=0 ; i<count ; i++)
+		cpus[i] = p[i].topo;
+	free(p);
+
+	return 0;
+}
+
+int pin_thread(pthread_t thread, const int cpu)
+{
+#if HAVE_PTHREAD_SETAFFINITY_NP
+	cpu_set_t cs;
+
+	CPU_ZERO(&cs);
+	CPU_SET(cpu, &cs);
+
+	return pthread_setaffinity_np(thread, sizeof(cs), &cs) ? -1 : 0;
+#else
+	return -1;
+#endif
+}
+
+int topology_current_cpu(void)
+{
+#if HAVE_SCHED_GETCPU
+	return sched_getcpu();
+#else
+	return -1;
+#endif
+}
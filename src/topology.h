@@ -0,0 +1,63 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <pthread.h>
+
+/* Core types of hybrid parts */
+enum core_type {
+	CORE_TYPE_UNKNOWN = -1,
+	CORE_TYPE_PERFORMANCE,
+	CORE_TYPE_EFFICIENCY,
+	CORE_TYPE_COUNT,
+};
+
+/* Fields are -1 when the information is not available */
+struct cpu_topo {
+	int cpu;
+	int core_id;
+	int package_id;
+	/* enum core_type, unknown on non hybrid parts */
+	int core_type;
+};
+
+/* Lists the logical CPUs the process is allowed to run on, in ascending
+ * order. Core types come from the cpu_core and cpu_atom PMUs in sysfs, or
+ * are read with CPUID leaf 0x1A from each cpu in turn on x86-64 when those
+ * are not available. *cpus must be freed by the caller. */
+int topology_get(struct cpu_topo **cpus, unsigned int *count);
+/* Describes a single cpu */
+void topology_fill(struct cpu_topo * const topo, const int cpu);
+char const * topology_core_type_name(const int core_type);
+
+/* Returns non-zero if a and b are SMT siblings of the same physical core */
+int topology_same_core(struct cpu_topo const * const a, struct cpu_topo const * const b);
+int topology_same_package(struct cpu_topo const * const a, struct cpu_topo const * const b);
+
+/* Reorders cpus so that packages are filled one after the other, and within
+ * a package, every physical core gets a thread before any SMT sibling does,
+ * performance cores before efficiency ones. Cpus of unknown topology keep their relative order. Returns non-zero on
+ * allocation failure, cpus being left untouched. */
+int topology_spread_order(struct cpu_topo * const cpus, const unsigned int count);
+
+int pin_thread(pthread_t thread, const int cpu);
+
+/* Returns the cpu the calling thread runs on, -1 if unknown */
+int topology_current_cpu(void);
+
+#endif
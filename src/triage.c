@@ -0,0 +1,246 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "triage.h"
+
+/* Elements waiting to be triaged */
+#define TRIAGE_QUEUE 16
+/* Distinct elements triaged over a run, failures of a broken core would
+ * otherwise keep the triage thread busy forever */
+#define TRIAGE_MAX 64
+
+struct triage_entry {
+	struct cpucheck_repro *repro;
+	int cpu;
+};
+
+struct triage {
+	pthread_t thread;
+	struct cpu_topo const *cpus;
+	unsigned int cpu_count;
+	unsigned long int rechecks;
+	pthread_mutex_t *output;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int should_exit;
+	struct triage_entry queue[TRIAGE_QUEUE];
+	unsigned int head;
+	unsigned int len;
+	/* Elements submitted so far, by table and address */
+	struct {
+		void const *table;
+		void const *element;
+	} seen[TRIAGE_MAX];
+	unsigned int nb_seen;
+	unsigned int saved;
+	unsigned long int skipped;
+};
+
+/* Runs rechecks checks on cpu, returns -1 if the thread could not move there */
+static long int recheck_on(struct triage * const triage, struct cpucheck_repro * const repro, const int cpu)
+{
+	if (pin_thread(pthread_self(), cpu))
+		return -1;
+	return cpucheck_repro_check(repro, triage->rechecks);
+}
+
+static void save(struct triage * const triage, struct cpucheck_repro const * const repro, char * const path, const size_t size)
+{
+	FILE *f;
+
+	snprintf(path, size, "cpucheck-%ld-%u.repro", (long int)getpid(), triage->saved++);
+	f = fopen(path, "w");
+	if (!f || cpucheck_repro_save(repro, f))
+		snprintf(path, size, "(could not save reproducer)");
+	if (f)
+		fclose(f);
+}
+
+static void triage_one(struct triage * const triage, struct triage_entry * const entry)
+{
+	char path[64];
+	long int here = -1, r;
+	unsigned int i, others = 0, failing = 0;
+	char const *verdict;
+
+	if (entry->cpu != -1)
+		here = recheck_on(triage, entry->repro, entry->cpu);
+	for (i=0 ; i<triage->cpu_count ; i++) {
+		if (triage->cpus[i].cpu == entry->cpu)
+			continue;
+		r = recheck_on(triage, entry->repro, triage->cpus[i].cpu);
+		if (r < 0)
+			continue;
+		others++;
+		failing += !!r;
+	}
+
+	if (others && failing == others && here)
+		verdict = "fails everywhere, the table or expected result is wrong";
+	else if (failing)
+		verdict = "fails on several cpus";
+	else if (here < 0)
+		verdict = "failing cpu unknown";
+	else if (!here)
+		verdict = "not reproduced";
+	else if ((unsigned long int)here == triage->rechecks)
+		verdict = "deterministic on this core";
+	else
+		verdict = "intermittent on this core";
+
+	save(triage, entry->repro, path, sizeof(path));
+
+	pthread_mutex_lock(triage->output);
+	fprintf(stderr, "Triage of %s element from cpu %d: ", cpucheck_repro_checker(entry->repro)->name, entry->cpu);
+	if (here >= 0)
+		fprintf(stderr, "failed %ld of %lu rechecks there, ", here, triage->rechecks);
+	if (others)
+		fprintf(stderr, "failed on %u of %u other cpus, ", failing, others);
+	fprintf(stderr, "%s, reproducer %s\n", verdict, path);
+	pthread_mutex_unlock(triage->output);
+}
+
+static void * triage_func(void *arg)
+{
+	struct triage * const triage = arg;
+	struct triage_entry entry;
+
+	pthread_mutex_lock(&triage->lock);
+	for (;;) {
+		while (!triage->len && !triage->should_exit)
+			pthread_cond_wait(&triage->cond, &triage->lock);
+		if (!triage->len)
+			break;
+
+		entry = triage->queue[triage->head];
+		triage->head = (triage->head+1) % TRIAGE_QUEUE;
+		triage->len--;
+
+		pthread_mutex_unlock(&triage->lock);
+		triage_one(triage, &entry);
+		cpucheck_repro_delete(entry.repro);
+		pthread_mutex_lock(&triage->lock);
+	}
+	pthread_mutex_unlock(&triage->lock);
+
+	return NULL;
+}
+
+struct triage * triage_start(struct cpu_topo const * const cpus, const unsigned int cpu_count,
+		const unsigned long int rechecks, pthread_mutex_t * const output)
+{
+	struct triage *triage;
+
+	triage = malloc(sizeof(*triage));
+	if (!triage) {
+		fprintf(stderr, "Could not allocate triage state\n");
+		return NULL;
+	}
+	triage->cpus = cpus;
+	triage->cpu_count = cpu_count;
+	triage->rechecks = rechecks;
+	triage->output = output;
+	triage->should_exit = 0;
+	triage->head = triage->len = 0;
+	triage->nb_seen = 0;
+	triage->saved = 0;
+	triage->skipped = 0;
+
+	if (pthread_mutex_init(&triage->lock, NULL) || pthread_cond_init(&triage->cond, NULL)) {
+		fprintf(stderr, "Could not allocate triage mutex\n");
+		goto err_triage;
+	}
+
+	if (pthread_create(&triage->thread, NULL, triage_func, triage)) {
+		fprintf(stderr, "Could not spawn triage thread\n");
+		goto err_lock;
+	}
+
+	return triage;
+
+err_lock:
+	pthread_cond_destroy(&triage->cond);
+	pthread_mutex_destroy(&triage->lock);
+err_triage:
+	free(triage);
+	return NULL;
+}
+
+void triage_submit(struct triage * const triage, struct cpucheck_table const * const table,
+		void const * const table_element, const int cpu)
+{
+	struct cpucheck_repro *repro = NULL;
+	unsigned int i;
+
+	/* Once every slot is taken, inconsistencies are only counted */
+	if (__atomic_load_n(&triage->nb_seen, __ATOMIC_RELAXED) == TRIAGE_MAX) {
+		__atomic_add_fetch(&triage->skipped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	pthread_mutex_lock(&triage->lock);
+
+	for (i=0 ; i<triage->nb_seen ; i++) {
+		if (triage->seen[i].table == table && triage->seen[i].element == table_element) {
+			pthread_mutex_unlock(&triage->lock);
+			return;
+		}
+	}
+
+	/* Elements of checkers with a delete callback cannot be copied */
+	if (cpucheck_table_checker(table)->delete || triage->nb_seen == TRIAGE_MAX || triage->len == TRIAGE_QUEUE
+			|| triage->should_exit || !(repro = cpucheck_repro_new(table, table_element))) {
+		__atomic_add_fetch(&triage->skipped, 1, __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&triage->lock);
+		return;
+	}
+
+	triage->seen[triage->nb_seen].table = table;
+	triage->seen[triage->nb_seen].element = table_element;
+	__atomic_store_n(&triage->nb_seen, triage->nb_seen+1, __ATOMIC_RELAXED);
+	triage->queue[(triage->head+triage->len) % TRIAGE_QUEUE].repro = repro;
+	triage->queue[(triage->head+triage->len) % TRIAGE_QUEUE].cpu = cpu;
+	triage->len++;
+	pthread_cond_signal(&triage->cond);
+
+	pthread_mutex_unlock(&triage->lock);
+}
+
+unsigned long int triage_stop(struct triage * const triage)
+{
+	unsigned long int skipped;
+
+	pthread_mutex_lock(&triage->lock);
+	triage->should_exit = 1;
+	pthread_cond_signal(&triage->cond);
+	pthread_mutex_unlock(&triage->lock);
+
+	pthread_join(triage->thread, NULL);
+
+	skipped = triage->skipped;
+	pthread_cond_destroy(&triage->cond);
+	pthread_mutex_destroy(&triage->lock);
+	free(triage);
+
+	return skipped;
+}
@@ -0,0 +1,42 @@
+/* Copyright Etienne Buira
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ */
+
+
+#ifndef TRIAGE_H
+#define TRIAGE_H
+
+#include <pthread.h>
+#include "libcpucheck.h"
+#include "topology.h"
+
+struct triage;
+
+/* Re-checks failing elements from a side thread, rechecks times on the cpu
+ * they failed on then on each of the other cpus, classifies them and saves a
+ * reproducer of each in the current directory. Messages are printed on
+ * stderr under output. */
+struct triage * triage_start(struct cpu_topo const * const cpus, const unsigned int cpu_count,
+		const unsigned long int rechecks, pthread_mutex_t * const output);
+/* Copies the element, so that the table may go away. Elements already
+ * triaged are ignored, elements submitted while the queue is full or that
+ * cannot be copied are skipped. cpu may be -1 if unknown. */
+void triage_submit(struct triage * const triage, struct cpucheck_table const * const table,
+		void const * const table_element, const int cpu);
+/* Triages pending elements, then stops the thread. Returns the number of
+ * skipped elements. */
+unsigned long int triage_stop(struct triage * const triage);
+
+#endif